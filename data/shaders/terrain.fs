@@ -0,0 +1,35 @@
+#version 330
+
+// Input vertex attributes (from vertex shader)
+in vec2 fragTexCoord;
+in vec3 fragNormal;
+
+// Input uniform values
+uniform sampler2D texture0;
+uniform sampler2D texture2;     // Normal map, one texel per vertex of the full resolution mesh
+uniform vec4 colDiffuse;
+uniform mat4 matNormal;
+uniform int useNormalMap;       // 1 if the normals are read from texture2 instead of the mesh
+
+// Output fragment color
+out vec4 finalColor;
+
+const vec3 lightDirection = vec3(-0.4, -1.0, -0.3);
+const float ambient = 0.35;
+
+void main()
+{
+    vec3 normal = fragNormal;
+    if (useNormalMap == 1)
+    {
+        // Texcoords run from the first to the last vertex, so they are moved onto the texel centers
+        vec2 size = vec2(textureSize(texture2, 0));
+        vec2 uv = (fragTexCoord*(size - 1.0) + 0.5)/size;
+        normal = mat3(matNormal)*(texture(texture2, uv).xyz*2.0 - 1.0);
+    }
+
+    float diffuse = max(dot(normalize(normal), -normalize(lightDirection)), 0.0);
+    vec4 texelColor = texture(texture0, fragTexCoord)*colDiffuse;
+
+    finalColor = vec4(texelColor.rgb*(ambient + (1.0 - ambient)*diffuse), texelColor.a);
+}
@@ -23,6 +23,10 @@ namespace DebugGui {
 		bool m_complexChange = false;
 		bool m_drawWired;
 		bool m_drawNormals;
+		float m_normalsDistance;
+		bool m_frustumCulling;
+		bool m_sortFrontToBack;
+		bool m_occlusionCulling;
 		float m_scale;
 		Color m_tint;
 	};
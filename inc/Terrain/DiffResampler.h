@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include "Terrain/ResidencyManager.h"
+
+namespace Terrain {
+	namespace DiffResampler {
+		// The resolution a diff has been made for, a diff holds numWidth * numHeight * 3 floats (vertex index = x * numHeight + z)
+		struct Layout {
+			int numWidth = 0;
+			int numHeight = 0;
+			float spacing = 0.0f;
+
+			bool operator==(const Layout& other) const = default;
+		};
+
+		/*
+		* The cells of the target layout that have at least one vertex inside of a cell of the source layout
+		* @param key The cell of the source layout
+		* @param from The layout of the source cell
+		* @param to The layout of the returned cells
+		*/
+		std::vector<ElementKey> getCoveredKeys(ElementKey key, const Layout& from, const Layout& to);
+
+		/*
+		* Fills the diff of a cell by bilinearly sampling the diffs of the source layout at the world position of every vertex
+		* Vertices over a cell without a diff get no difference
+		* @param sources The diffs of the source layout, by the key of their cell
+		* @param from The layout of the source diffs
+		* @param key The cell the diff is built for
+		* @param to The layout of the cell
+		* @param target The diff that is filled (to.numWidth * to.numHeight * 3 floats)
+		*/
+		void resample(const ResidencyManager::DiffMap& sources, const Layout& from, ElementKey key, const Layout& to, float* target);
+	}
+}
\ No newline at end of file
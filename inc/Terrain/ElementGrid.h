@@ -0,0 +1,75 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Terrain/ManipulableTerrainElement.h"
+
+namespace Terrain {
+	/*
+	* Fixed capacity ring buffer of terrain elements, indexed by the cell coordinates of the elements modulo the window size
+	* Every cell inside the current window has exactly one slot, so lookups never hash and elements never move while the window moves
+	*/
+	class ElementGrid {
+	public:
+		// Walks the occupied slots in storage order, which is spatial order within the window
+		class iterator {
+		public:
+			iterator(const ElementGrid* grid, int slot);
+
+			ManipulableTerrainElement& operator*() const;
+			ManipulableTerrainElement* operator->() const;
+			iterator& operator++();
+			iterator operator++(int);
+			bool operator==(const iterator& other) const;
+			bool operator!=(const iterator& other) const;
+
+		private:
+			friend class ElementGrid;
+
+			const ElementGrid* m_grid;
+			int m_slot;
+
+			void skipEmpty();
+		};
+
+		ElementGrid() = default;
+		ElementGrid(const ElementGrid& other) = delete;
+		ElementGrid& operator=(const ElementGrid& other) = delete;
+
+		/*
+		* Moves the window to start at the given cell and hands out every element that is not inside of it anymore
+		* If the size stays the same only the cells leaving the window are visited, otherwise every element is moved into a new slot
+		* @param originX The first cell along x inside of the window
+		* @param originZ The first cell along z inside of the window
+		* @param width The number of cells along x
+		* @param height The number of cells along z
+		* @param released Receives the elements that left the window
+		*/
+		void setWindow(int originX, int originZ, int width, int height, std::vector<std::unique_ptr<ManipulableTerrainElement>>& released);
+		bool inWindow(int cellX, int cellZ) const;
+		ManipulableTerrainElement* get(int cellX, int cellZ) const; // nullptr if the cell is empty or outside of the window
+		ManipulableTerrainElement* find(ElementKey key) const;
+		ManipulableTerrainElement& insert(std::unique_ptr<ManipulableTerrainElement> element); // The cell of the element has to be empty and inside of the window
+		std::unique_ptr<ManipulableTerrainElement> release(int cellX, int cellZ); // Takes the element out of the grid, nullptr if the cell is empty
+		void releaseAll(std::vector<std::unique_ptr<ManipulableTerrainElement>>& released);
+
+		iterator begin() const;
+		iterator end() const;
+		size_t size() const;
+		bool empty() const;
+		int getOriginX() const;
+		int getOriginZ() const;
+		int getWidth() const;
+		int getHeight() const;
+
+	private:
+		std::vector<std::unique_ptr<ManipulableTerrainElement>> m_slots; // width * height slots, slot = (cellX mod width) + (cellZ mod height) * width
+		int m_originX = 0;
+		int m_originZ = 0;
+		int m_width = 0;
+		int m_height = 0;
+		size_t m_size = 0; // The number of occupied slots
+
+		int toSlot(int cellX, int cellZ) const;
+		void releaseCells(int firstX, int lastX, int firstZ, int lastZ, std::vector<std::unique_ptr<ManipulableTerrainElement>>& released);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+
+namespace Terrain {
+	/*
+	* Decides how much main thread work the terrain may do per frame, from the measured frame time instead of a fixed share of it
+	* The time left for the terrain is what the last frame had to spare besides the terrain, the bytes uploaded to the GPU
+	* grow while work is waiting and the target is kept, and shrink quickly once frames get slower than the target
+	*/
+	class FrameBudget {
+	public:
+		/*
+		* Starts the work of a new frame
+		* @param frameTime The duration of the last frame in seconds, including everything besides the terrain
+		* @param targetFrameTime The duration a frame should not exceed in seconds
+		*/
+		void beginFrame(float frameTime, float targetFrameTime);
+		void endFrame();
+		bool hasTimeLeft() const;
+		bool tryUpload(size_t numBytes); // Books the upload if it fits the budget, the first upload of a frame always fits so large ones can't stall
+
+		float getWorkTime() const; // The seconds the terrain may work this frame
+		float getLastWorkTime() const; // The seconds the terrain worked last frame
+		size_t getUploadBudget() const;
+		size_t getLastUploadedBytes() const;
+		int getLastNumDeferred() const; // The number of uploads left for a later frame, since they did not fit into the budget
+
+	private:
+		double m_frameStart = 0.0;
+		float m_workTime = 0.0f;
+		float m_lastWorkTime = 0.0f;
+		float m_minWorkTime = 0.0005f; // Some work is always done, so backlogs drain even while the frame is too slow
+		size_t m_uploadBudget = 1024 * 1024; // Bytes per frame
+		size_t m_minUploadBudget = 64 * 1024;
+		size_t m_maxUploadBudget = 256 * 1024 * 1024;
+		size_t m_uploadedBytes = 0;
+		size_t m_lastUploadedBytes = 0;
+		int m_numDeferred = 0;
+		int m_lastNumDeferred = 0;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include <raylib.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include "ThreadPool.h"
+#include "Terrain/TerrainElement.h"
+
+namespace Terrain {
+	/*
+	* Holds the generation jobs of terrain elements until the thread pool has room for them
+	* Jobs are handed out closest to the viewer first, elements in front of the viewer before the ones behind it
+	* There is at most one job per element key, jobs that have not started yet can be cancelled
+	* Every function can be called from any thread, except dispatch() which has to be called on the thread updating the pool
+	*/
+	class GenerationScheduler {
+	public:
+		typedef std::shared_ptr<std::atomic<bool>> DoneFlag;
+
+		/*
+		* Queues a job, replacing the pending job of the same key if there is one
+		* @param key The key of the element the job generates
+		* @param center The center of the element in world space, used to prioritise the job
+		* @param task The job itself
+		* @param idle True if the job is only handed out once no other job is waiting
+		*/
+		void schedule(ElementKey key, Vector3 center, std::function<void()> task, bool idle = false);
+		void promote(ElementKey key); // Gives the pending job of the key normal priority, if it was scheduled as idle
+
+		/*
+		* Drops the pending job of the key
+		* @return DoneFlag The flag that is set once the job finishes if it is already running, nullptr otherwise
+		*/
+		DoneFlag cancel(ElementKey key);
+		void cancelAll();
+
+		/*
+		* Hands the most important jobs to the pool, until it has maxQueued tasks waiting
+		* @param viewPosition The position jobs are prioritised around
+		* @param viewDirection The direction the viewer looks at, jobs behind the viewer count as farther away
+		*/
+		void dispatch(ThreadPool& pool, Vector3 viewPosition, Vector3 viewDirection, int maxQueued);
+
+		int getNumPending() const;
+		int getNumRunning() const;
+
+	private:
+		struct Job {
+			Vector3 center;
+			std::function<void()> task;
+			bool idle; // Idle jobs are handed out after every other job
+		};
+
+		mutable std::mutex m_mutex; // Guards both maps, since jobs are scheduled and cancelled by the relocation worker
+		std::unordered_map<ElementKey, Job, ElementKeyHash> m_pending;
+		std::unordered_map<ElementKey, DoneFlag, ElementKeyHash> m_running;
+
+		float getPriority(const Job& job, Vector3 viewPosition, Vector3 viewDirection) const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+#include <raylib.h>
+#include <vector>
+#include "Noise.h"
+
+namespace Terrain {
+	namespace GridKernels {
+		/*
+		* The loops working on the vertex grid of an element (vertex index = x * numHeight + z)
+		* Every kernel exists once for runtime dimensions and once per supported fixed size, so strides and trip counts are constants
+		*/
+		struct Kernels {
+			/*
+			* Writes the flat grid positions without any height
+			* @param vertices The vertices of the grid (numWidth * numHeight * 3 floats)
+			* @param spacing The distance between each vertex
+			*/
+			void (*fillFlatVertices)(float* vertices, int numWidth, int numHeight, float spacing);
+
+			/*
+			* Sums the noise layers into one height per vertex
+			* @param heights The heights to write (numWidth * numHeight floats)
+			* @param noiseLayers The noise layer images, stored row by row (pixel index = z * numWidth + x)
+			* @param layerSettings The settings of every noise layer
+			*/
+			void (*composeHeights)(float* heights, const std::vector<Color*>& noiseLayers, const std::vector<Noise::noise_layer_settings>& layerSettings, int numWidth, int numHeight);
+
+			/*
+			* Writes the heights into the y component of the vertices
+			* @param vertices The vertices of the grid (numWidth * numHeight * 3 floats)
+			* @param heights The heights (numWidth * numHeight floats)
+			*/
+			void (*applyHeights)(float* vertices, const float* heights, int numWidth, int numHeight);
+
+			/*
+			* Adds the difference multiplied by sign to every vertex
+			* @param vertices The vertices of the grid (numWidth * numHeight * 3 floats)
+			* @param difference The difference (numWidth * numHeight * 3 floats)
+			* @param sign 1.0f to add the difference, -1.0f to remove it
+			*/
+			void (*applyDifference)(float* vertices, const float* difference, float sign, int numWidth, int numHeight);
+
+			/*
+			* Computes the normals from the neighbouring vertices for the vertices between min and max (inclusive)
+			* @param vertices The vertices of the grid (numWidth * numHeight * 3 floats)
+			* @param normals The normals to write (numWidth * numHeight * 3 floats)
+			*/
+			void (*computeNormals)(const float* vertices, float* normals, int numWidth, int numHeight, int minX, int minZ, int maxX, int maxZ);
+		};
+
+		/*
+		* Picks the kernels for the given element size
+		* @param numWidth The number of verticies along the width of the grid
+		* @param numHeight The number of verticies along the height of the grid
+		* @return const Kernels& The kernels specialised for the size (33, 65, 129 or 257 along both sides) or the generic ones
+		*/
+		const Kernels& getKernels(int numWidth, int numHeight);
+
+		bool isSpecialised(int numWidth, int numHeight);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+#include <raylib.h>
+#include <vector>
+
+namespace Terrain {
+	/*
+	* Conservative occlusion test for heightfield terrain seen from a single view position
+	* The horizon is stored per azimuth bin as the highest elevation slope (height / horizontal distance) that is guaranteed
+	* to be covered by terrain, together with the distance from which on that slope hides everything behind it
+	* Boxes have to be added roughly front to back for the horizon to grow, the result stays correct in any order
+	*/
+	class HorizonCuller {
+	public:
+		HorizonCuller(int numBins = 256);
+
+		void reset(Vector3 viewPosition);
+		bool isOccluded(BoundingBox box) const;
+		void addOccluder(BoundingBox box);
+
+		int getNumBins() const;
+
+	private:
+		struct AngularRange {
+			float start; // Azimuth where the range starts, may be negative
+			float end; // Azimuth where the range ends, always greater or equal to start
+			float minDistance; // Horizontal distance to the closest point of the box
+			float maxDistance; // Horizontal distance to the farthest corner of the box
+		};
+
+		int m_numBins;
+		Vector3 m_viewPosition = { 0.0f, 0.0f, 0.0f };
+		std::vector<float> m_horizonSlopes; // The highest slope covered by terrain per azimuth bin
+		std::vector<float> m_horizonDistances; // The distance from which on the slope of the bin occludes
+
+		bool computeRange(BoundingBox box, AngularRange& range) const;
+		int toBin(int bin) const;
+	};
+}
\ No newline at end of file
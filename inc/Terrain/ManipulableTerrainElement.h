@@ -25,10 +25,9 @@ namespace Terrain {
 		};
 
 		~ManipulableTerrainElement();
-		ManipulableTerrainElement(std::shared_ptr<terrain_settings> settings, PositionIdentifier posId, std::shared_ptr<float[]> heightDifference);
-		ManipulableTerrainElement(PositionIdentifier posId);
-		ManipulableTerrainElement(const TerrainElement& other);
-		ManipulableTerrainElement(const ManipulableTerrainElement& other);
+		ManipulableTerrainElement(std::shared_ptr<terrain_settings> settings, ElementKey key, std::shared_ptr<float[]> heightDifference);
+		ManipulableTerrainElement(const ManipulableTerrainElement& other) = delete;
+		ManipulableTerrainElement& operator=(const ManipulableTerrainElement& other) = delete;
 
 		void manipulateTerrain(ManipulateDir dir, ManipulateForm form, ManipulateType type, float strength, float radius, Vector3 relativePosition);
 		void loadDifference(std::shared_ptr<float[]> heightDifference);
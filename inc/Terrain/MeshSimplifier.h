@@ -0,0 +1,18 @@
+#pragma once
+#include <raylib.h>
+
+namespace Terrain {
+	namespace MeshSimplifier {
+		/*
+		* Builds a reduced mesh from a regular vertex grid (vertex index = x * numHeight + z) by merging
+		* blocks of quads whose vertices all lie within maxError of the plane spanned by the block corners
+		* @param vertices The grid vertices (numWidth * numHeight * 3 floats)
+		* @param normals The grid normals (numWidth * numHeight * 3 floats), nullptr uses an up vector
+		* @param numWidth The number of verticies along the width of the grid
+		* @param numHeight The number of verticies along the height of the grid
+		* @param maxError The maximum distance a dropped vertex may have from the simplified surface
+		* @return Mesh A new mesh, that is not uploaded and owns its own data
+		*/
+		Mesh simplifyGrid(const float* vertices, const float* normals, int numWidth, int numHeight, float maxError);
+	}
+}
\ No newline at end of file
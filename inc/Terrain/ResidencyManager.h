@@ -0,0 +1,96 @@
+#pragma once
+#include <raylib.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include "Terrain/ManipulableTerrainElement.h"
+
+namespace Terrain {
+	/*
+	* Keeps the memory of the terrain inside of byte budgets by moving the data farthest from the camera into cheaper tiers
+	* Elements are either uploaded (GPU) or only keep their mesh (CPU), the budget of the CPU limits how many elements exist at all
+	* The edit diffs of elements that left the terrain are kept raw, compressed in memory or stored on disk, and restored once the element comes back
+	*/
+	class ResidencyManager {
+	public:
+		typedef std::unordered_map<ElementKey, std::shared_ptr<float[]>, ElementKeyHash> DiffMap;
+
+		struct TierStats {
+			int numGpuElements = 0; // The number of uploaded elements
+			size_t gpuBytes = 0; // The bytes the uploaded elements use on the GPU
+			int numCpuElements = 0; // The number of elements that are only kept on the CPU
+			size_t cpuBytes = 0; // The bytes of mesh data every element keeps on the CPU
+			int numPinnedElements = 0; // The number of edited elements that are kept uploaded since they are close to the camera
+			int numRawDiffs = 0; // The number of diffs kept as floats
+			size_t rawDiffBytes = 0;
+			int numCompressedDiffs = 0; // The number of diffs compressed in memory
+			size_t compressedDiffBytes = 0;
+			int numDiskDiffs = 0; // The number of diffs stored on disk
+			size_t diskDiffBytes = 0;
+		};
+
+		// A diff taken out of the tiers without decoding it, so any thread can decode it later
+		struct StoredDiff {
+			std::vector<unsigned char> data; // The compressed diff, empty if it is on disk
+			std::string path; // The file the diff has been moved to, empty if it was compressed in memory
+		};
+
+		ResidencyManager(std::string cacheDirectory = "data/cache/diffs");
+		~ResidencyManager();
+		ResidencyManager(const ResidencyManager& other) = delete;
+		ResidencyManager& operator=(const ResidencyManager& other) = delete;
+
+		/*
+		* Uploads the closest elements until the GPU budget is used up and frees the GPU buffers of all farther ones, main thread only
+		* @param elements The elements of the terrain
+		* @param viewPosition The position the distances are measured from, in the space of the elements
+		* @param gpuBudget The bytes the uploaded elements may use, 0 is unlimited
+		* @param pinDistance Elements with a difference closer than this stay uploaded, even if the budget is used up
+		*/
+		void updateElements(const std::vector<ManipulableTerrainElement*>& elements, Vector3 viewPosition, size_t gpuBudget, float pinDistance);
+
+		/*
+		* Moves the diffs no element uses, farthest first, from raw floats into compressed memory and onto disk until the budget is kept
+		* Diffs that only mark an element without any edits are dropped, since a new one is created if the element comes back
+		* @param diffs The diffs of the terrain, the ones moved into a tier are taken out of it
+		* @param viewPosition The position the distances are measured from, in the space of the elements
+		* @param cellWidth The width of one element
+		* @param cellHeight The height of one element
+		* @param diffSize The number of floats of one diff
+		* @param diffBudget The bytes the raw and compressed diffs may use together, 0 is unlimited
+		*/
+		void updateDiffs(DiffMap& diffs, Vector3 viewPosition, float cellWidth, float cellHeight, size_t diffSize, size_t diffBudget);
+		bool restoreDiff(ElementKey key, DiffMap& diffs); // Moves a compressed or stored diff back into diffs, false if there is none
+		void forEachStoredDiff(const std::function<void(ElementKey key, const std::vector<float>& diff)>& func) const; // Decodes every diff that is not in diffs, for saving
+		std::vector<std::pair<ElementKey, StoredDiff>> takeStoredDiffs(); // Moves every compressed and stored diff out of the tiers, files are renamed so new diffs can use their keys
+		static std::vector<float> decodeDiff(const StoredDiff& diff); // Decodes a taken diff and removes its file, safe on any thread
+		void clear(); // Drops every compressed and stored diff
+
+		/*
+		* The number of elements that fit into the CPU budget
+		* @param cpuBudget The bytes the meshes of the elements may use, 0 is unlimited
+		* @param numWidth The number of vertices along the width of an element
+		* @param numHeight The number of vertices along the height of an element
+		* @return unsigned int The number of elements, UINT_MAX if the budget is unlimited
+		*/
+		static unsigned int getMaxElements(size_t cpuBudget, int numWidth, int numHeight);
+		TierStats getStats() const;
+
+	private:
+		std::string m_cacheDirectory; // Where diffs past the budget are written to, one file per element
+		std::unordered_map<ElementKey, std::vector<unsigned char>, ElementKeyHash> m_compressedDiffs;
+		std::unordered_map<ElementKey, size_t, ElementKeyHash> m_diskDiffs; // The size of the file of every stored diff
+		TierStats m_stats;
+		unsigned int m_numTakenFiles = 0; // Keeps the names of taken files unique, taking happens again before older ones are decoded
+		mutable std::mutex m_mutex; // Guards the tiers and m_stats, diffs are moved by the relocation worker while the stats are read by the GUI
+
+		std::string getDiffPath(ElementKey key) const;
+		static std::vector<unsigned char> compress(const float* diff, size_t size);
+		static std::vector<float> decompress(const std::vector<unsigned char>& data);
+		bool writeToDisk(ElementKey key, const std::vector<unsigned char>& data);
+		std::vector<unsigned char> readFromDisk(ElementKey key) const;
+	};
+}
\ No newline at end of file
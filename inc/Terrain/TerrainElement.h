@@ -3,11 +3,15 @@
 #include <raymath.h>
 #include <memory>
 #include <vector>
+#include <mutex>
+#include <cstdint>
 #include "MeshObject.h"
 #include "Noise.h"
 #include "ThreadPool.h"
 #include "Entity.h"
 #include "Character.h"
+#include "MeshArena.h"
+#include "GridKernels.h"
 
 #define MAX_MESH_VBO 7
 
@@ -21,49 +25,81 @@ namespace Terrain {
 		ThreadPool* threadPool = nullptr;
 		Character* camera = nullptr;
 		float distToRelocating = 0.0f;
+		bool useBufferArena = true; // True if elements share large GPU buffers instead of uploading their own
+		std::shared_ptr<MeshArena> bufferArena; // The arena new elements are uploaded into (owner is TerrainManager)
 
 		// Terrain element
 		int numWidth; // The number of verticies along the width of the terrain elements
 		int numHeight; // The number of verticies along the height of the terrain elements
 		float spacing; // The distance between each vertex
+		int clusterSize = 32; // The number of quads along each side of a cluster, clusters are culled individually when drawing
+		bool simplifyMeshes = false; // True if a reduced mesh should be built for drawing and ray queries
+		float simplificationError = 0.05f; // The maximum height error the reduced mesh may have
+		bool useNormalMaps = false; // True if simplified meshes are lit from a normal texture baked from the full resolution mesh
+		float prefetchTime = 0.0f; // Seconds of camera movement ahead of which elements are generated, 0 disables prefetching
+		float gpuBudget = 0.0f; // Megabytes the uploaded meshes may use, the farthest elements beyond it are not uploaded, 0 is unlimited
+		float cpuBudget = 0.0f; // Megabytes the generated meshes may use, limits the number of elements closest first, 0 is unlimited
+		float diffBudget = 0.0f; // Megabytes the edit diffs of elements that left the terrain may use in memory, the rest is compressed or stored on disk, 0 is unlimited
+		float pinDistance = 0.0f; // Edited elements closer than this to the camera are never demoted
 	};
 
-	struct PositionIdentifier {
-		int x = 0; // The x-Index of the element
-		int i = 1; // -1 if element is in left half, 1 if element is in right half of terrain
-		int z = 0; // The z-Index of the element
-		int n = 1; // -1 if element is in top half, 1 if element is in bottom half of terrain
+	/*
+	* Packs the signed cell coordinates of an element into one 64 bit value, cell 0 starts at 0 and cell -1 ends at 0
+	* Every pair of cells has its own key, so it can be used as id, map key and save key without collisions
+	*/
+	struct ElementKey {
+		int64_t value = 0; // cellX in the upper 32 bits, cellZ in the lower 32 bits
 
-		PositionIdentifier() = default;
-		PositionIdentifier(int x, int i, int z, int n) : x(x), i(i), z(z), n(n) {}
-		PositionIdentifier(const PositionIdentifier& other) : x(other.x), i(other.i), z(other.z), n(other.n) {}
+		ElementKey() = default;
+		ElementKey(int cellX, int cellZ) : value(static_cast<int64_t>((static_cast<uint64_t>(static_cast<uint32_t>(cellX)) << 32) | static_cast<uint32_t>(cellZ))) {}
 
-		bool operator==(const PositionIdentifier& other) const {
-			return x == other.x && i == other.i && z == other.z && n == other.n;
+		int getCellX() const {
+			return static_cast<int32_t>(static_cast<uint32_t>(static_cast<uint64_t>(value) >> 32));
+		}
+
+		int getCellZ() const {
+			return static_cast<int32_t>(static_cast<uint32_t>(value));
+		}
+
+		bool operator==(const ElementKey& other) const {
+			return value == other.value;
 		}
 	};
 
-	struct PositionIdentifierHash {
-		std::size_t operator()(const PositionIdentifier& pos) const {
-			return std::hash<int>()(pos.x) ^ std::hash<int>()(pos.i) ^
-				std::hash<int>()(pos.z) ^ std::hash<int>()(pos.n);
+	struct ElementKeyHash {
+		std::size_t operator()(const ElementKey& key) const {
+			// Finaliser of splitmix64, so neighbouring cells spread over the whole range instead of clustering in a few buckets
+			uint64_t hash = static_cast<uint64_t>(key.value);
+			hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+			return static_cast<std::size_t>(hash ^ (hash >> 31));
 		}
 	};
 
 	class TerrainElement : public MeshObject, public Entity<Vector3> {
 	public:
+		struct Cluster {
+			BoundingBox boundingBox; // The bounds of all vertices of the cluster
+			int indexOffset; // The first index of the cluster in the index buffer
+			int indexCount; // The number of indices of the cluster
+			int startX; // The first vertex column of the cluster
+			int startZ; // The first vertex row of the cluster
+			int endX; // The last vertex column of the cluster
+			int endZ; // The last vertex row of the cluster
+		};
+
 		virtual ~TerrainElement();
-		TerrainElement(std::shared_ptr<terrain_settings> settings, PositionIdentifier posId);
-		TerrainElement(PositionIdentifier posId);
-		TerrainElement(const TerrainElement& other);
+		TerrainElement(std::shared_ptr<terrain_settings> settings, ElementKey key);
+		TerrainElement(const TerrainElement& other) = delete; // Elements own their mesh, GPU and noise data, so they are never copied
+		TerrainElement& operator=(const TerrainElement& other) = delete;
 
-		int getIdFromPosId(PositionIdentifier posId);
 		void initialiseMesh();
 		void initialiseElementWithFlatTerrain();
 		void initialiseElementWithNoiseTerrain(std::shared_ptr<Noise::noise_settings> noiseSettings);
 		void updateNoiseLayers();
 		void randomizeTerrain();
 		void updateNormals();
+		void updateNormals(int minX, int minZ, int maxX, int maxZ);
 		void updatePosition();
 		void Upload();
 		void Unload();
@@ -71,14 +107,37 @@ namespace Terrain {
 		void reloadMeshData();
 		void renewMeshData();
 		void update(int targetFPS);
+		void beginSimplification(float maxError);
+		void simplifyMesh();
+		bool needsSimplification(float maxError) const;
+		bool isSimplifying() const; // True while a worker may still be simplifying the mesh
+		void dropSimplifiedMesh();
+		void releaseGpuData(); // Main thread only, frees every GPU buffer of the element but keeps the mesh, so setting the upload flag uploads it again
 
 		// GETTER AND SETTER
 		unsigned int getId() const;
-		PositionIdentifier getPosId() const;
+		ElementKey getKey() const;
 		Mesh& refMesh();
+		Mesh& refDrawMesh();
+		bool isDrawable() const;
+		bool isReady() const; // True once the generated mesh has been sent to the GPU, or the element is meant to stay on the CPU
+		const std::vector<Cluster>& getClusters() const;
+		bool consumeDrawMeshChanged();
 		void setModelUploaded(std::shared_ptr<bool> modelUploaded);
 		std::atomic<bool>* getReloadFlag();
 		std::atomic<bool>* getUploadFlag();
+		std::atomic<bool>* getSimplifiedFlag();
+		MeshArena* getArena() const;
+		std::shared_ptr<MeshArena> getSharedArena() const;
+		int getArenaSlot() const;
+		bool isGpuResident() const;
+		size_t getGpuBytes() const; // The bytes the element uses on the GPU, or would use once uploaded
+		size_t getPendingUploadBytes() const; // The bytes the next update() sends to the GPU
+		size_t getCpuBytes() const; // The bytes of mesh data the element keeps on the CPU
+		int getModelSlot() const;
+		void setModelSlot(int modelSlot);
+		Texture2D getNormalMap(); // The normal map of the mesh refDrawMesh() returns, id is 0 if it has none
+		const std::vector<float>& refNormalLines(); // Main thread only, rebuilds the lines if the mesh changed since they were built
 
 		bool operator==(const TerrainElement& other) const {
 			return id == other.id;
@@ -86,10 +145,10 @@ namespace Terrain {
 
 	protected:
 		// General
-		unsigned int id = 0; // The unique identifier of the terrain element, which is based on its position
+		unsigned int id = 0; // The unique identifier of the terrain element, counted up for every new element
 		std::shared_ptr<terrain_settings> settings; // The settings of the terrain (owner is Terrain struct)
 		// Vector3 m_position = { 0, 0, 0 }; // The position of the bottom left corner (local x and y = 0) of the terrain Element
-		PositionIdentifier posId; // Used to store information about the position of a element in the terrain
+		ElementKey key; // The cell of the element in the terrain
 		std::atomic<bool> m_reload{ false };
 		std::atomic<bool> m_upload{ false };
 
@@ -97,12 +156,48 @@ namespace Terrain {
 		bool dynamicMesh = false; // True if the mesh is dynamic, false otherwise
 		bool meshUploaded = false; // True if the mesh has been uploaded to the GPU, false otherwise
 		std::shared_ptr<bool> modelUploaded; // The modelUploaded flag of the terrain (owner is Terrain struct)
+		std::shared_ptr<MeshArena> m_arena; // The arena the mesh is uploaded into, nullptr if the mesh has its own buffers
+		int m_arenaSlot = -1; // The slot of the mesh in m_arena
+		int m_modelSlot = -1; // The index of the mesh in the model of the terrain, -1 if it is not part of it
+		std::atomic<unsigned int> m_meshVersion{ 0 }; // Increased every time the vertices of the mesh change, 0 if the mesh has not been generated yet
+		std::atomic<bool> m_drawMeshChanged{ false }; // True if refDrawMesh() returns a different mesh than before
+		std::vector<float> m_normalLines; // The end points of the normals of m_mesh for debug drawing, only built once they are drawn
+		unsigned int m_normalLinesVersion = 0; // The mesh version m_normalLines was built from
+
+		// Simplification
+		Mesh m_simplifiedMesh = { 0 }; // Reduced mesh used for drawing and ray queries, m_mesh stays the editable source of truth
+		Mesh m_pendingSimplifiedMesh = { 0 }; // Reduced mesh built by a worker, that still has to be uploaded
+		std::vector<float> m_simplificationVertices; // Snapshot of the vertices the worker simplifies
+		std::vector<float> m_simplificationNormals; // Snapshot of the normals the worker simplifies
+		unsigned int m_simplifiedVersion = 0; // The mesh version m_simplifiedMesh was built from
+		unsigned int m_pendingVersion = 0; // The mesh version m_pendingSimplifiedMesh is built from
+		float m_simplificationError = 0.0f; // The error bound m_simplifiedMesh was built with
+		float m_pendingError = 0.0f; // The error bound m_pendingSimplifiedMesh is built with
+		bool m_simplifiedUploaded = false;
+		std::atomic<bool> m_simplifying{ false }; // True while a simplification is queued or running
+		std::atomic<bool> m_simplified{ false }; // Set once m_pendingSimplifiedMesh is ready to be uploaded
+		bool m_pendingBakeNormalMap = false; // True if the worker bakes a normal map together with the simplified mesh
+		std::vector<Color> m_pendingNormalMap; // Baked by the worker from the full resolution normals, one texel per vertex
+		Texture2D m_normalMap = { 0 }; // Kept after the simplified mesh is dropped, so the next bake only updates it
+		bool m_hasNormalMap = false; // True if m_normalMap has been baked for m_simplifiedMesh
 
 		// Noise
 		std::shared_ptr<Noise::noise_settings> noiseSettings; // The noise settings of the terrain
-		std::vector<Color*> noiseLayerPixels; // The pixels of the different noise layers
+		std::vector<Color*> noiseLayerPixels; // The pixels of the different noise layers, only kept while the heights are composed
+		std::vector<float> m_baseHeights; // The heights generated from the noise, without any difference applied
+		std::shared_ptr<std::vector<unsigned short>> m_sharedIndices; // The indices of the mesh, shared by every element with the same grid
+		const GridKernels::Kernels* m_kernels = nullptr; // The grid loops for the size of this element, picked when the mesh is initialised
+
+		// Clusters
+		std::vector<Cluster> m_clusters; // Fixed size blocks of quads, each owning one contiguous range of the index buffer
+		bool m_boundsDirty = true; // True if any vertex could have left the bounds of its cluster
+		bool m_regionDirty = false; // True if only the vertices between m_dirtyMin and m_dirtyMax have changed since the bounds were updated
+		int m_dirtyMinX = 0; // The first changed vertex column
+		int m_dirtyMinZ = 0; // The first changed vertex row
+		int m_dirtyMaxX = 0; // The last changed vertex column
+		int m_dirtyMaxZ = 0; // The last changed vertex row
 
-		Vector3 getPositionFromPosId();
+		Vector3 getPositionFromKey();
 		void flatTerrainVertices();
 		void flatTerrainTexcoords();
 		void flatTerrainNormals();
@@ -110,5 +205,19 @@ namespace Terrain {
 		template<typename T>
 		void copyVectorToMemory(T*& dst, std::vector<T> src, bool uploaded);
 		void initialiseFlatMesh();
+		void restoreBaseHeights();
+		void unloadMesh();
+		void initialiseClusters();
+		void updateClusterBounds();
+		void updateClusterBounds(Cluster& cluster);
+		void updateDirtyBounds();
+		void updateElementBounds();
+		void markBoundsDirty();
+		void markBoundsDirty(int minX, int minZ, int maxX, int maxZ);
+		void installSimplifiedMesh();
+		void bakeNormalMap();
+		void uploadNormalMap();
+		bool uploadIntoArena();
+		void releaseArenaSlot();
 	};
 }
\ No newline at end of file
@@ -1,28 +1,37 @@
 #pragma once
 #include <raylib.h>
 #include <memory>
+#include <unordered_map>
 #include <unordered_set>
 #include <string>
 #include <mutex>
 #include "Terrain/ManipulableTerrainElement.h"
+#include "Terrain/ElementGrid.h"
+#include "Terrain/GenerationScheduler.h"
+#include "Terrain/ResidencyManager.h"
+#include "Terrain/FrameBudget.h"
+#include "Terrain/DiffResampler.h"
 #include "ModelObject.h"
 #include "Actor.h"
 #include "FileAdapters/JSONAdapter.h"
 #include "ThreadPool.h"
-
-// Custom hash function for ManipulableTerrain
-namespace std {
-	template<>
-	struct hash<Terrain::ManipulableTerrainElement> {
-		size_t operator()(const Terrain::ManipulableTerrainElement& element) const {
-			return std::hash<unsigned int>()(element.getId());
-		}
-	};
-}
+#include "Frustum.h"
+#include "MeshRenderer.h"
+#include "ShaderHandler.h"
+#include "Terrain/HorizonCuller.h"
 
 namespace Terrain {
 	class TerrainManager : public ModelObject, public Actor<Vector3>, public Drawable {
 	public:
+		typedef ResidencyManager::DiffMap ManipulationMap;
+
+		struct HashStats {
+			size_t numEntries = 0; // The number of keys in the map
+			size_t numBuckets = 0; // The number of buckets of the map
+			size_t numUsedBuckets = 0; // The number of buckets holding at least one key
+			size_t maxBucketSize = 0; // The number of keys in the fullest bucket
+		};
+
 		TerrainManager(std::string name, terrain_settings terrainSettings);
 		TerrainManager(std::string name, std::string filename);
 		TerrainManager(const FileAdapter& settings);
@@ -33,7 +42,8 @@ namespace Terrain {
 		void loadNoiseSettings(const FileAdapter& settingsFile);
 		void initializeNoise();
 		void updateTerrain(float oldRadius);
-		void renewTerrain();
+		void renewTerrain(terrain_settings terrainSettings); // Replaces the settings, the old terrain keeps its own and is drawn until every element of the new one is ready
+		bool isRenewing() const;
 		
 		void updateTerrainNoise();
 		void manipulateTerrain(ManipulableTerrainElement::ManipulateDir dir, ManipulableTerrainElement::ManipulateForm form, ManipulableTerrainElement::ManipulateType type, float strength, float radius, Vector3 position);
@@ -46,6 +56,45 @@ namespace Terrain {
 
 		void setThreadPool(ThreadPool* threadPool);
 		void setCamera(Character* camera);
+		bool getFrustumCulling() const;
+		void setFrustumCulling(bool frustumCulling);
+		bool getSortFrontToBack() const;
+		void setSortFrontToBack(bool sortFrontToBack);
+		bool getOcclusionCulling() const;
+		void setOcclusionCulling(bool occlusionCulling);
+		float getNormalsDistance() const;
+		void setNormalsDistance(float normalsDistance);
+		int getNumVisibleElements() const;
+		int getNumCulledElements() const;
+		int getNumOccludedElements() const;
+		int getNumVisibleClusters() const;
+		int getNumCulledClusters() const;
+		int getNumArenaPages() const;
+		int getNumArenaSlots() const;
+		int getNumPendingGenerations() const;
+		int getNumRunningGenerations() const;
+		int getNumWarmElements() const;
+		HashStats getManipulationHashStats() const; // How evenly the edit diffs spread over the buckets of their map, as of the last relocation or update
+		ResidencyManager::TierStats getResidencyStats() const;
+		const FrameBudget& getFrameBudget() const;
+
+		/*
+		* Adds a circle, besides the one around the camera, inside of which elements are generated and kept
+		* Elements inside of several circles are only generated once and shared, the budget of elements is split by the weights
+		* @param viewer The character the circle follows
+		* @param radius The radius of the circle
+		* @param weight The share of the budget of elements, relative to the camera which has a weight of 1
+		* @return int The id of the region
+		* Changes to the regions are queued and applied by the next update(), so callers never wait for a relocation
+		*/
+		int addInterestRegion(Character* viewer, float radius, float weight);
+		int addInterestRegion(Vector3 position, float radius, float weight); // A region that stays at position until it is moved
+		void removeInterestRegion(int id);
+		void setInterestRegionPosition(int id, Vector3 position); // Only used if the region does not follow a viewer
+		void setInterestRegion(int id, float radius, float weight);
+		int getNumInterestRegions() const;
+		int getNumSharedElements() const; // The number of elements referenced by interest regions
+		int getNumDiffResamples() const; // The number of diffs still being resampled to the current resolution
 
 		void save() const;
 		void save(std::string filename) const;
@@ -60,25 +109,201 @@ namespace Terrain {
 		RayCollision getRayCollisionWithTerrain(Ray ray, RayCollision boundingBoxHit);
 
 	protected:
+		// The elements of the grid at one point in time, never changed after being published, so readers don't have to lock m_updating
+		struct ElementSnapshot {
+			std::vector<ManipulableTerrainElement*> elements; // In grid order
+		};
+
+		struct ModelChange {
+			ManipulableTerrainElement* element; // Kept alive until the change is applied, since retired elements are only freed after updateModel()
+			bool add; // True if the element joined the grid, false if it left it
+		};
+
+		struct InterestRegion {
+			int id = 0;
+			Character* viewer = nullptr; // The character the region follows, nullptr if it stays at position
+			Vector3 position = { 0.0f, 0.0f, 0.0f }; // The center of the region in world space, if it has no viewer
+			float radius = 0.0f;
+			float weight = 1.0f; // The share of the budget of elements, relative to the camera
+			std::vector<ElementKey> cells; // The cells the region holds a reference to
+			int cellX = 0; // The cell the center of the region has been in when the cells were picked
+			int cellZ = 0;
+			bool dirty = true; // True if the cells have to be picked again, even if the center stayed in its cell
+		};
+
+		struct InterestRegionChange {
+			enum Type {
+				ADD,
+				REMOVE,
+				MOVE,
+				RESHAPE
+			};
+
+			Type type;
+			InterestRegion region; // The id and the fields the type changes
+		};
+
+		struct SharedElement {
+			std::unique_ptr<ManipulableTerrainElement> element; // nullptr while the grid owns the element
+			unsigned int refCount = 0; // The number of interest regions referencing the element
+		};
+		typedef std::unordered_map<ElementKey, SharedElement, ElementKeyHash> SharedElementMap;
+
+		struct DiffResample;
+		// An old diff shared by the tasks of every new cell it overlaps, loaded by the first task that needs it
+		struct DiffSource {
+			std::shared_ptr<float[]> diff; // Set right away for raw diffs, otherwise once loaded
+			ResidencyManager::StoredDiff stored; // Decoded on load, if the diff has been in a cheaper tier
+			std::shared_ptr<DiffResample> pending; // Run on load, if the diff is the target of an earlier resampling that did not finish yet
+			size_t size = 0; // The number of floats the diff has to have
+			std::once_flag loaded;
+		};
+
+		struct DiffResample {
+			ElementKey key; // The cell the diff is resampled for
+			DiffResampler::Layout from; // The resolution of the sources
+			DiffResampler::Layout to; // The resolution of the target
+			std::unordered_map<ElementKey, std::shared_ptr<DiffSource>, ElementKeyHash> sources; // The old diffs overlapping the cell, released once the target is filled
+			std::shared_ptr<float[]> target; // Already in m_loadedManipulations, but only read once resampled is done
+			std::once_flag resampled; // Run by whichever comes first, the task on the thread pool or the generation of the element
+			std::atomic<bool> filled{ false }; // Set once the target is filled, by whichever thread did it
+			std::atomic<bool> done{ false }; // Set by the thread pool once its task ran
+		};
+		typedef std::unordered_map<ElementKey, std::shared_ptr<DiffResample>, ElementKeyHash> DiffResampleMap;
+
+		struct RetiredElement {
+			std::unique_ptr<ManipulableTerrainElement> element; // The element that left the terrain
+			GenerationScheduler::DoneFlag done; // Set once the generation job still using the element is done, nullptr if there is none
+			std::vector<GenerationScheduler::DoneFlag> noiseDone; // Set once the noise updates queued for the element are done
+			std::weak_ptr<const ElementSnapshot> snapshot; // The last snapshot containing the element, it is not freed while a reader holds it
+			std::weak_ptr<const ElementSnapshot> outgoingSnapshot; // The snapshot drawn while a renewal generates, it may be older than snapshot and still contain the element
+		};
+
 		std::shared_ptr<terrain_settings> settings; // The terrain settings
 		std::shared_ptr<Noise::noise_settings> noiseSettings; // The noise settings
 
 		std::shared_ptr<bool> modelUploaded = std::make_shared<bool>(false); // True if the model has been uploaded to the GPU, false otherwise
-		std::unordered_set<ManipulableTerrainElement> elements; // The terrain elements
+		std::vector<std::shared_ptr<MeshArena>> m_bufferArenas; // Every arena elements have been uploaded into, kept until no element uses it anymore, so it is unloaded on the main thread
+		ElementGrid elements; // The terrain elements, held by pointer in the slot of their cell, so they never move or get copied
 		std::atomic<bool> m_updateModel{ false };
-		std::mutex m_updating; // Any thread that could cause update() to crash (example: deleting elements from elements) locks this firts preventing updating
+		std::vector<ModelChange> m_modelChanges; // The elements that joined or left the grid since the last updateModel() (guarded by m_updating)
+		std::vector<ManipulableTerrainElement*> m_modelElements; // The element of every mesh of the model, by model slot
+		int m_modelCapacity = 0; // The number of meshes the arrays of the model have room for
+		GenerationScheduler m_generationScheduler; // Hands out the generation of new elements closest to the camera first
+		typedef std::unordered_map<ElementKey, std::unique_ptr<ManipulableTerrainElement>, ElementKeyHash> WarmElementMap;
+		WarmElementMap m_warmElements; // Elements generated ahead of the camera, not drawn until relocation moves them into the grid (guarded by m_updating)
+		std::atomic<int> m_numWarmElements{ 0 };
+		Vector3 m_lastCameraPosition = { 0.0f, 0.0f, 0.0f };
+		bool m_hasCameraPosition = false;
+		Vector3 m_cameraVelocity = { 0.0f, 0.0f, 0.0f }; // Smoothed velocity of the camera in world units per second
+		Vector3 m_prefetchCenter = { 0.0f, 0.0f, 0.0f }; // Where the camera is expected to be after the prefetch time
+		std::atomic<std::shared_ptr<const ElementSnapshot>> m_snapshot{ std::make_shared<const ElementSnapshot>() }; // Replaced as a whole by publishSnapshot() whenever the grid changed
+		std::atomic<int> m_numQueuedRenewals{ 0 }; // Renewals waiting for or running on the thread pool, the grid still holds the old elements until they ran
+		std::atomic<std::shared_ptr<const ElementSnapshot>> m_outgoingSnapshot; // The elements from before renewTerrain(), drawn instead of m_snapshot until it is ready, keeping them alive
+		std::vector<InterestRegion> m_interestRegions; // (guarded by m_updating)
+		std::atomic<int> m_nextInterestRegionId{ 0 };
+		std::vector<InterestRegionChange> m_interestRegionChanges; // Queued by the public functions, applied by updateInterestRegions() (guarded by m_interestRegionChangesMutex)
+		std::mutex m_interestRegionChangesMutex;
+		SharedElementMap m_sharedElements; // Every cell referenced by an interest region, owning the element if it is outside of the grid (guarded by m_updating)
+		std::atomic<int> m_numInterestRegions{ 0 };
+		std::atomic<int> m_numSharedElements{ 0 };
+		DiffResampler::Layout m_diffLayout; // The resolution the diffs in m_loadedManipulations have been made for
+		DiffResampleMap m_diffResamples; // The diffs being resampled after the resolution changed, by their new cell (guarded by m_updating)
+		std::atomic<int> m_numDiffResamples{ 0 };
+		std::vector<std::pair<const ManipulableTerrainElement*, GenerationScheduler::DoneFlag>> m_noiseTasks; // The noise updates handed to the thread pool, by their element (guarded by m_updating)
+		std::vector<RetiredElement> m_retiredElements; // Elements taken out of the grid, freed by the main thread once no job uses them (guarded by m_updating)
+		mutable std::mutex m_updating; // Any thread that could cause update() to crash (example: deleting elements from elements) locks this firts preventing updating
 		Vector3 center = { 0.0f, 0.0f, 0.0f };
-		std::unordered_map<PositionIdentifier, std::shared_ptr<float[]>, PositionIdentifierHash> m_loadedManipulations;
+		std::vector<std::pair<int, int>> m_spawnColumns; // The first and last cell along z of every column of the spawn circle, relative to the window, empty if the next relocation has to visit every cell
+		std::atomic<bool> m_relocationQueued{ false }; // True while a relocation waits for the thread pool, so it is only queued once
+		bool m_hasBounds = false; // True if m_boundingBox contains at least one element
+		ManipulationMap m_loadedManipulations; // The raw edit diffs of every element that has existed, by element key, the others are held by m_residency
+		HashStats m_manipulationHashStats; // Taken from m_loadedManipulations while m_updating is held, so the GUI never walks the map itself
+		mutable std::mutex m_hashStatsMutex; // Guards m_manipulationHashStats
+		ResidencyManager m_residency; // Keeps elements and diffs inside of the memory budgets of the settings
+		std::shared_ptr<const ElementSnapshot> m_residencySnapshot; // The snapshot the tiers of the elements have been decided for
+		Vector3 m_residencyPosition = { 0.0f, 0.0f, 0.0f }; // The position the tiers of the elements have been decided for
+		float m_residencyBudget = 0.0f; // The GPU budget the tiers of the elements have been decided for
+		float m_residencyPinDistance = 0.0f; // The pin distance the tiers of the elements have been decided for
+		FrameBudget m_frameBudget; // How long update() may work and how many bytes it may upload this frame
+		size_t m_updateCursor = 0; // The index into the snapshot the next frame starts updating elements at
+		size_t m_numUpdatedElements = 0; // The elements updated since the last complete pass over the snapshot
+
+		// Drawing
+		bool m_frustumCulling = true; // True if elements outside of the camera frustum are not drawn
+		int m_numVisibleElements = 0; // The number of elements drawn last frame
+		int m_numCulledElements = 0; // The number of elements skipped last frame
+		bool m_occlusionCulling = true; // True if elements hidden behind closer terrain are not drawn
+		HorizonCuller m_horizonCuller; // Rebuilt every frame while drawing the render queue
+		int m_numOccludedElements = 0; // The number of elements skipped last frame since they were below the horizon
+		int m_numVisibleClusters = 0; // The number of clusters drawn last frame
+		int m_numCulledClusters = 0; // The number of clusters skipped last frame inside of visible elements
+		std::vector<MeshRenderer::IndexRange> m_visibleRanges; // Reused every frame to collect the index ranges of visible clusters
+		std::vector<MeshArena::DrawCommand> m_arenaCommands; // Reused every frame to collect the draws of elements living in the current arena
+		bool m_sortFrontToBack = true; // True if elements are drawn ordered by their distance to the camera, reducing overdraw
+		std::vector<ManipulableTerrainElement*> m_renderQueue; // The elements in the order they are drawn
+		std::shared_ptr<const ElementSnapshot> m_renderSnapshot; // The snapshot the render queue has been built from, keeping its elements alive
+		std::atomic<bool> m_renderQueueDirty{ true }; // True if the elements changed since the render queue has been built
+		Vector3 m_renderQueuePosition = { 0.0f, 0.0f, 0.0f }; // The camera position the render queue has been sorted for
+		ShaderHandler m_terrainShader; // Lights the terrain, used instead of the default shader while normal maps are enabled
+		int m_useNormalMapLoc = -1; // The location of the useNormalMap uniform of m_terrainShader
+		float m_normalsDistance = 0.0f; // Normals are only drawn for elements closer to the camera than this, 0 draws them everywhere
 
 		Model newModel();
-		void initialiseAndAddNewElement(std::unordered_set<ManipulableTerrainElement>& newElements, const PositionIdentifier& posId);
+		void initialiseAndAddNewElement(ElementKey key);
+		std::unique_ptr<ManipulableTerrainElement> createElement(ElementKey key, bool prefetch); // prefetch schedules the generation at idle priority
+		void updateCameraVelocity();
+		void updatePrefetch();
+		void retireWarmElements(bool onlyUnreachable);
+		void dispatchGenerationJobs();
+		void retireElement(std::unique_ptr<ManipulableTerrainElement> element, bool published = true); // published is false for elements that never were in a snapshot
+		void publishSnapshot(); // Has to be called with m_updating locked, after elements have been added to or removed from the grid
+		std::shared_ptr<const ElementSnapshot> getSnapshot() const;
+		std::shared_ptr<const ElementSnapshot> getDrawnSnapshot() const; // m_outgoingSnapshot while a renewal generates, otherwise the current snapshot
+		void updateRetiredElements();
+		void simplifyElement(ManipulableTerrainElement* element);
 		float getSpawnHeightAtXPos(const float x, const float spawnRadius);
-		void loadElementsIntoModel(); // Sets meshCount of model and loads the meshes of the elements into the model
-		void initializeModelMaterials(); // Initializes the model with the default material and sets it to be the material of every mesh
+		std::vector<std::pair<int, int>> getSpawnColumns(int numPerQuadrantX, int numPerQuadrantZ);
+		unsigned int getMaxNumElements() const; // maxNumElements, lowered if fewer elements fit into the CPU budget
+		unsigned int getElementShare(float weight) const; // The part of getMaxNumElements() a region with this weight may use
+		void onInterestRegionsChanged(); // Has to be called with m_updating locked
+		void queueInterestRegionChange(InterestRegionChange change);
+		bool applyInterestRegionChanges(); // Returns true if the budget of elements has to be split again
+		void updateInterestRegions();
+		void acquireSharedElement(ElementKey key);
+		void releaseSharedElement(ElementKey key);
+		void releaseInterestRegions(); // Retires every element owned by a region, the regions pick their cells again on the next update
+		void dropGridElement(std::unique_ptr<ManipulableTerrainElement> element); // Hands an element that left the grid to the regions still referencing it, or retires it
+		void updateResidency(const std::shared_ptr<const ElementSnapshot>& snapshot);
+		bool updateSnapshotElements(const std::shared_ptr<const ElementSnapshot>& snapshot, int targetFPS); // Returns true once every element has been updated, possibly across several frames
+		void updateGrid(); // Has to be called with m_updating locked
+		void updateManipulationHashStats(); // Has to be called with m_updating locked
+		void renewElements(); // Has to be called with m_updating locked
+		void updateOutgoingTerrain(const std::shared_ptr<const ElementSnapshot>& snapshot); // Stops drawing the old terrain once every element of the snapshot is ready
+		DiffResampler::Layout getDiffLayout() const; // The resolution of the current settings
+		void resampleDiffs(); // Has to be called with m_updating locked, before elements of a new resolution are created
+		static void runDiffResample(DiffResample& resample); // Fills the target, unless another thread already did
+		static void loadDiffSource(DiffSource& source); // Decodes or resamples the diff, unless another thread already did
+		void updateDiffResamples();
+		void addToModel(ManipulableTerrainElement* element); // Appends the mesh of the element to the model, growing its arrays if they are full
+		void removeFromModel(ManipulableTerrainElement* element); // Moves the last mesh of the model into the slot of the element
+		void initializeModelMaterials(); // Initializes the model with the default material, only done once
+		void loadTerrainShader();
+		bool useTerrainShader(Material& material); // Swaps in m_terrainShader if normal maps are enabled, returns true if it did
+		void setNormalMap(Material& material, Texture2D normalMap);
 		void updateElementsNoise();
 		void updateModel();
 		void relocateElements();
-		PositionIdentifier getPositionIdentifierFromKey(std::string key);
+		void drawElementNormals(ManipulableTerrainElement& element, const BoundingBox& box, Matrix transform);
+		Matrix getModelTransform() const;
+		void drawElements();
+		void updateRenderQueue();
+		void collectVisibleClusters(ManipulableTerrainElement& element, const Frustum& frustum);
+		void updateBufferArenas();
+		void updateTerrainBounds();
+		void growTerrainBounds(ManipulableTerrainElement& element);
+		BoundingBox toWorldBox(BoundingBox box, Vector3 offset) const;
+		ElementKey getElementKeyFromString(std::string key);
 
 		void saveTerrainSettings(FileAdapter& json) const;
 		void saveNoiseSettings(FileAdapter& jsone) const;
@@ -0,0 +1,17 @@
+#pragma once
+#include <raylib.h>
+#include <raymath.h>
+
+class Frustum {
+public:
+	Frustum();
+	Frustum(const Camera& camera, float aspect);
+	Frustum(Matrix viewProjection);
+
+	bool containsBox(BoundingBox box) const;
+
+private:
+	Vector4 m_planes[6]; // Left, right, bottom, top, near and far plane as (a, b, c, d), points inside satisfy ax + by + cz + d >= 0
+
+	void extractPlanes(Matrix viewProjection);
+};
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+#include <raylib.h>
+#include <vector>
+#include <mutex>
+#include "MeshRenderer.h"
+
+/*
+* Suballocates the vertex data of many meshes with the same topology from a few large GPU buffers
+* Every mesh gets a fixed size slot for its positions and normals, texcoords and indices are uploaded once and shared by all slots
+* Slots are grouped into pages, each page is one vertex array, so meshes of the same page are drawn without changing buffers
+*/
+class MeshArena {
+public:
+	struct DrawCommand {
+		int slot; // The slot to draw
+		MeshRenderer::IndexRange range; // The range of the shared index buffer to draw
+		Vector3 offset; // Translation applied before the transformation of the draw call
+	};
+
+	~MeshArena();
+	MeshArena(int slotVertexCount, const float* texcoords, const unsigned short* indices, int indexCount, int slotsPerPage = 64);
+	MeshArena(const MeshArena& other) = delete;
+	MeshArena& operator=(const MeshArena& other) = delete;
+
+	bool fits(int vertexCount, const unsigned short* indices, int indexCount) const;
+	int allocate(); // Main thread only, since it may create a new page
+	void release(int slot); // Can be called from any thread
+	void update(int slot, const float* vertices, const float* normals); // Main thread only
+	void draw(const Material& material, Matrix transform, const std::vector<DrawCommand>& commands) const; // Main thread only
+
+	int getSlotVertexCount() const;
+	int getIndexCount() const;
+	int getNumPages() const;
+	int getNumUsedSlots() const;
+
+private:
+	struct Page {
+		unsigned int vaoId = 0;
+		unsigned int positionVboId = 0;
+		unsigned int normalVboId = 0;
+	};
+
+	int m_slotVertexCount; // The number of vertices every slot holds
+	int m_slotsPerPage; // The number of slots in every page
+	std::vector<float> m_texcoords; // Kept to be uploaded again for every new page
+	std::vector<unsigned short> m_indices; // Kept to check if a mesh shares the topology of the arena
+	unsigned int m_texcoordVboId = 0; // Texcoords of one slot, shared by every slot
+	unsigned int m_indexVboId = 0; // Indices of one slot, shared by every slot
+	std::vector<Page> m_pages;
+
+	mutable std::mutex m_slotMutex; // Guards the slot bookkeeping, since slots are released from worker threads
+	std::vector<int> m_freeSlots;
+	std::vector<bool> m_usedSlots;
+	int m_numUsedSlots = 0;
+
+	void addPage();
+	void bindSlot(int slot) const;
+};
\ No newline at end of file
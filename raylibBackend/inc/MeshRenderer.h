@@ -0,0 +1,64 @@
+#pragma once
+#include <raylib.h>
+#include <vector>
+
+namespace MeshRenderer {
+	struct IndexRange {
+		int offset; // The first index to draw
+		int count; // The number of indices to draw
+	};
+
+	/*
+	* Binds the shader of the material and sets the same uniforms and textures DrawMesh() would
+	* Vertex arrays can then be bound and drawn directly until endDraw() is called
+	* @param material The material to draw with
+	* @param transform The model transformation
+	*/
+	void beginDraw(const Material& material, Matrix transform);
+
+	/*
+	* Replaces the model transformation between beginDraw() and endDraw(), without binding the shader and textures again
+	* @param material The material beginDraw() has been called with
+	* @param transform The new model transformation
+	*/
+	void setTransform(const Material& material, Matrix transform);
+
+	/*
+	* Unbinds the textures and the shader bound by beginDraw()
+	* @param material The same material beginDraw() has been called with
+	*/
+	void endDraw(const Material& material);
+
+	/*
+	* Draws only the given ranges of the index buffer of an uploaded mesh, with the same shader setup as DrawMesh()
+	* @param mesh The uploaded mesh, that has to have indices
+	* @param material The material to draw the mesh with
+	* @param transform The model transformation
+	* @param ranges The ranges of the index buffer to draw
+	*/
+	void drawMeshRanges(const Mesh& mesh, const Material& material, Matrix transform, const std::vector<IndexRange>& ranges);
+
+	/*
+	* Builds the end points of lines that show the normals of a mesh, every normal becomes a line from the vertex to vertex + normal * length
+	* @param lines The end points of the lines, two points (6 floats) per vertex
+	* @param vertices The vertices of the mesh (vertexCount * 3 floats)
+	* @param normals The normals of the mesh (vertexCount * 3 floats)
+	* @param vertexCount The number of vertices of the mesh
+	* @param length The length of the lines
+	*/
+	void updateNormalLines(std::vector<float>& lines, const float* vertices, const float* normals, int vertexCount, float length);
+
+	/*
+	* Draws lines as line primitives through the render batch of rlgl
+	* @param lines The end points of the lines, two points (6 floats) per line
+	* @param transform The model transformation
+	* @param color The color of the lines
+	*/
+	void drawLines(const std::vector<float>& lines, Matrix transform, Color color);
+
+	/*
+	* Frees the vertex array and buffers of an uploaded mesh, but keeps its data on the CPU, so it can be uploaded again
+	* @param mesh The uploaded mesh, its vaoId and vboId are reset
+	*/
+	void unloadMeshBuffers(Mesh& mesh);
+}
\ No newline at end of file
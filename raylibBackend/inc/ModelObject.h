@@ -38,7 +38,5 @@ protected:
 	bool m_drawNormals;
 
 	void updateBoundingBox();
-
-private:
 	void drawNormals();
 };
\ No newline at end of file
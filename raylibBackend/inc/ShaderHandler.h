@@ -9,9 +9,12 @@ public:
 
 	void activate();
 	void deactivate();
+	void draw(); // The handler draws nothing itself, the shader is applied through activate() or getShader()
 	void useShader(Shader shader);
+	Shader getShader() const;
+	bool hasShader() const;
 
 private:
-	Shader m_shader;
+	Shader m_shader = { 0 };
 	bool shaderSet = false;
 };
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <thread>
 #include <functional>
 #include <atomic>
+#include <mutex>
 #include "Updatable.h"
 
 class ThreadPool : public Updatable {
@@ -15,6 +16,8 @@ public:
 	void shutdown();
 
 	void addTask(std::function<void()> task, std::atomic<bool>* flag);
+	int getNumThreads() const;
+	int getNumQueuedTasks() const; // Tasks that have been added but not handed to a thread yet
 
 private:
 	const int m_numberOfThreads;
@@ -24,6 +27,7 @@ private:
 	std::atomic<bool>* m_isFree;
 	std::queue<std::function<void()>> m_tasksQueue;
 	std::queue<std::atomic<bool>*> m_flagsQueue;
+	mutable std::mutex m_queueMutex; // Guards both queues, tasks may be added from any thread
 	std::atomic<bool> m_shutdown{ false };
 
 	static void ThreadRunner(const std::atomic<bool>* shutdown, const std::function<void()>* task, std::atomic<bool>** returnFlag, std::atomic<bool>* isFree);
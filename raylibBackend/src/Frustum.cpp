@@ -0,0 +1,61 @@
+#include "Frustum.h"
+#include <rlgl.h>
+#include <cmath>
+
+Frustum::Frustum() {
+	// Without a camera every box is inside
+	for (int i = 0; i < 6; i++) {
+		m_planes[i] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	}
+}
+
+Frustum::Frustum(const Camera& camera, float aspect) {
+	// Same projection as BeginMode3D() sets up
+	double nearPlane = rlGetCullDistanceNear();
+	double farPlane = rlGetCullDistanceFar();
+	Matrix projection;
+	if (camera.projection == CAMERA_ORTHOGRAPHIC) {
+		double top = camera.fovy / 2.0;
+		double right = top * aspect;
+		projection = MatrixOrtho(-right, right, -top, top, nearPlane, farPlane);
+	}
+	else projection = MatrixPerspective(camera.fovy * DEG2RAD, aspect, nearPlane, farPlane);
+
+	extractPlanes(MatrixMultiply(GetCameraMatrix(camera), projection));
+}
+
+Frustum::Frustum(Matrix viewProjection) {
+	extractPlanes(viewProjection);
+}
+
+void Frustum::extractPlanes(Matrix m) {
+	// Rows of the combined matrix, planes are sums and differences of the last row with the others
+	Vector4 row1 = { m.m0, m.m4, m.m8, m.m12 };
+	Vector4 row2 = { m.m1, m.m5, m.m9, m.m13 };
+	Vector4 row3 = { m.m2, m.m6, m.m10, m.m14 };
+	Vector4 row4 = { m.m3, m.m7, m.m11, m.m15 };
+
+	m_planes[0] = Vector4Add(row4, row1);
+	m_planes[1] = Vector4Subtract(row4, row1);
+	m_planes[2] = Vector4Add(row4, row2);
+	m_planes[3] = Vector4Subtract(row4, row2);
+	m_planes[4] = Vector4Add(row4, row3);
+	m_planes[5] = Vector4Subtract(row4, row3);
+
+	for (Vector4& plane : m_planes) {
+		float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		if (length > 0.0f) plane = Vector4Scale(plane, 1.0f / length);
+	}
+}
+
+bool Frustum::containsBox(BoundingBox box) const {
+	for (const Vector4& plane : m_planes) {
+		// Only the corner furthest along the plane normal has to be checked
+		float x = plane.x >= 0.0f ? box.max.x : box.min.x;
+		float y = plane.y >= 0.0f ? box.max.y : box.min.y;
+		float z = plane.z >= 0.0f ? box.max.z : box.min.z;
+		if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f) return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include "MeshArena.h"
+#include <rlgl.h>
+#include <raymath.h>
+#include <cstring>
+#include <algorithm>
+
+MeshArena::~MeshArena() {
+	for (Page& page : m_pages) {
+		rlUnloadVertexBuffer(page.positionVboId);
+		rlUnloadVertexBuffer(page.normalVboId);
+		rlUnloadVertexArray(page.vaoId);
+	}
+	rlUnloadVertexBuffer(m_texcoordVboId);
+	rlUnloadVertexBuffer(m_indexVboId);
+
+	TraceLog(LOG_DEBUG, "MeshArena: Unloaded %i pages", static_cast<int>(m_pages.size()));
+}
+
+MeshArena::MeshArena(int slotVertexCount, const float* texcoords, const unsigned short* indices, int indexCount, int slotsPerPage) : m_slotVertexCount(slotVertexCount), m_slotsPerPage(std::max(slotsPerPage, 1)), m_texcoords(texcoords, texcoords + slotVertexCount * 2), m_indices(indices, indices + indexCount) {
+	m_texcoordVboId = rlLoadVertexBuffer(m_texcoords.data(), static_cast<int>(m_texcoords.size() * sizeof(float)), false);
+	m_indexVboId = rlLoadVertexBufferElement(m_indices.data(), static_cast<int>(m_indices.size() * sizeof(unsigned short)), false);
+
+	TraceLog(LOG_DEBUG, "MeshArena: New arena with %i vertices per slot has been created", m_slotVertexCount);
+}
+
+bool MeshArena::fits(int vertexCount, const unsigned short* indices, int indexCount) const {
+	if (vertexCount != m_slotVertexCount || indexCount != static_cast<int>(m_indices.size()) || indices == nullptr) return false;
+	return memcmp(indices, m_indices.data(), m_indices.size() * sizeof(unsigned short)) == 0;
+}
+
+int MeshArena::allocate() {
+	std::lock_guard<std::mutex> lock(m_slotMutex);
+	if (m_freeSlots.empty()) addPage();
+
+	int slot = m_freeSlots.back();
+	m_freeSlots.pop_back();
+	m_usedSlots[slot] = true;
+	m_numUsedSlots++;
+	return slot;
+}
+
+void MeshArena::release(int slot) {
+	std::lock_guard<std::mutex> lock(m_slotMutex);
+	if (slot < 0 || slot >= static_cast<int>(m_usedSlots.size()) || !m_usedSlots[slot]) return;
+
+	// The old data stays in the buffers until the slot is allocated and updated again, it is just not drawn anymore
+	m_usedSlots[slot] = false;
+	m_freeSlots.push_back(slot);
+	m_numUsedSlots--;
+}
+
+void MeshArena::update(int slot, const float* vertices, const float* normals) {
+	const Page& page = m_pages[slot / m_slotsPerPage];
+	int slotSize = m_slotVertexCount * 3 * sizeof(float);
+	int offset = (slot % m_slotsPerPage) * slotSize;
+	rlUpdateVertexBuffer(page.positionVboId, vertices, slotSize, offset);
+	if (normals) rlUpdateVertexBuffer(page.normalVboId, normals, slotSize, offset);
+}
+
+void MeshArena::draw(const Material& material, Matrix transform, const std::vector<DrawCommand>& commands) const {
+	if (commands.empty()) return;
+
+	MeshRenderer::beginDraw(material, transform);
+
+	int boundPage = -1;
+	int boundSlot = -1;
+	Vector3 offset = { 0.0f, 0.0f, 0.0f };
+	bool offsetSet = false;
+	for (const DrawCommand& command : commands) {
+		// Only the matrices change between meshes, the shader and its textures stay bound
+		if (!offsetSet || !Vector3Equals(offset, command.offset)) {
+			MeshRenderer::setTransform(material, MatrixMultiply(MatrixTranslate(command.offset.x, command.offset.y, command.offset.z), transform));
+			offset = command.offset;
+			offsetSet = true;
+		}
+		int page = command.slot / m_slotsPerPage;
+		if (page != boundPage) {
+			rlEnableVertexArray(m_pages[page].vaoId);
+			boundPage = page;
+		}
+		if (command.slot != boundSlot) {
+			bindSlot(command.slot);
+			boundSlot = command.slot;
+		}
+		rlDrawVertexArrayElements(command.range.offset, command.range.count, 0);
+	}
+	rlDisableVertexArray();
+
+	MeshRenderer::endDraw(material);
+}
+
+int MeshArena::getSlotVertexCount() const {
+	return m_slotVertexCount;
+}
+
+int MeshArena::getIndexCount() const {
+	return static_cast<int>(m_indices.size());
+}
+
+int MeshArena::getNumPages() const {
+	return static_cast<int>(m_pages.size());
+}
+
+int MeshArena::getNumUsedSlots() const {
+	std::lock_guard<std::mutex> lock(m_slotMutex);
+	return m_numUsedSlots;
+}
+
+void MeshArena::addPage() {
+	Page page;
+	int pageSize = m_slotsPerPage * m_slotVertexCount * 3 * sizeof(float);
+
+	// Same attribute setup UploadMesh() uses, positions and normals are pointed at the slot when it is drawn
+	page.vaoId = rlLoadVertexArray();
+	rlEnableVertexArray(page.vaoId);
+
+	page.positionVboId = rlLoadVertexBuffer(nullptr, pageSize, true);
+	rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 3, RL_FLOAT, false, 0, 0);
+	rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+
+	rlEnableVertexBuffer(m_texcoordVboId);
+	rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD, 2, RL_FLOAT, false, 0, 0);
+	rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD);
+
+	page.normalVboId = rlLoadVertexBuffer(nullptr, pageSize, true);
+	rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL, 3, RL_FLOAT, false, 0, 0);
+	rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL);
+
+	float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	rlSetVertexAttributeDefault(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, white, SHADER_ATTRIB_VEC4, 4);
+	rlDisableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR);
+
+	rlEnableVertexBufferElement(m_indexVboId);
+	rlDisableVertexArray();
+
+	// Slots are handed out from the back, so the first slot of the page is used first
+	int firstSlot = static_cast<int>(m_pages.size()) * m_slotsPerPage;
+	for (int slot = firstSlot + m_slotsPerPage - 1; slot >= firstSlot; slot--) {
+		m_freeSlots.push_back(slot);
+	}
+	m_usedSlots.resize(firstSlot + m_slotsPerPage, false);
+	m_pages.push_back(page);
+
+	TraceLog(LOG_DEBUG, "MeshArena: Added page %i with %i slots", static_cast<int>(m_pages.size()) - 1, m_slotsPerPage);
+}
+
+void MeshArena::bindSlot(int slot) const {
+	const Page& page = m_pages[slot / m_slotsPerPage];
+	int offset = (slot % m_slotsPerPage) * m_slotVertexCount * 3 * sizeof(float);
+
+	rlEnableVertexBuffer(page.positionVboId);
+	rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 3, RL_FLOAT, false, 0, offset);
+	rlEnableVertexBuffer(page.normalVboId);
+	rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL, 3, RL_FLOAT, false, 0, offset);
+	rlDisableVertexBuffer();
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "MeshRenderer.h"
+#include <raymath.h>
+#include <rlgl.h>
+
+namespace MeshRenderer {
+	namespace {
+		constexpr int NUM_MATERIAL_MAPS = MATERIAL_MAP_BRDF + 1; // MAX_MATERIAL_MAPS is internal to raylib, but only the named maps can be set
+
+		void setColorUniform(int location, Color color) {
+			if (location == -1) return;
+
+			float values[4] = { color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f };
+			rlSetUniform(location, values, SHADER_UNIFORM_VEC4, 1);
+		}
+	} // private namespace
+
+	void beginDraw(const Material& material, Matrix transform) {
+		rlEnableShader(material.shader.id);
+
+		setColorUniform(material.shader.locs[SHADER_LOC_COLOR_DIFFUSE], material.maps[MATERIAL_MAP_DIFFUSE].color);
+		setColorUniform(material.shader.locs[SHADER_LOC_COLOR_SPECULAR], material.maps[MATERIAL_MAP_SPECULAR].color);
+		setTransform(material, transform);
+
+		for (int i = 0; i < NUM_MATERIAL_MAPS; i++) {
+			if (material.maps[i].texture.id == 0) continue;
+			rlActiveTextureSlot(i);
+			rlEnableTexture(material.maps[i].texture.id);
+			rlSetUniform(material.shader.locs[SHADER_LOC_MAP_DIFFUSE + i], &i, SHADER_UNIFORM_INT, 1);
+		}
+	}
+
+	void setTransform(const Material& material, Matrix transform) {
+		Matrix matView = rlGetMatrixModelview();
+		Matrix matProjection = rlGetMatrixProjection();
+		Matrix matModel = MatrixMultiply(transform, rlGetMatrixTransform());
+		if (material.shader.locs[SHADER_LOC_MATRIX_VIEW] != -1) rlSetUniformMatrix(material.shader.locs[SHADER_LOC_MATRIX_VIEW], matView);
+		if (material.shader.locs[SHADER_LOC_MATRIX_PROJECTION] != -1) rlSetUniformMatrix(material.shader.locs[SHADER_LOC_MATRIX_PROJECTION], matProjection);
+		if (material.shader.locs[SHADER_LOC_MATRIX_MODEL] != -1) rlSetUniformMatrix(material.shader.locs[SHADER_LOC_MATRIX_MODEL], matModel);
+		if (material.shader.locs[SHADER_LOC_MATRIX_NORMAL] != -1) rlSetUniformMatrix(material.shader.locs[SHADER_LOC_MATRIX_NORMAL], MatrixTranspose(MatrixInvert(matModel)));
+		rlSetUniformMatrix(material.shader.locs[SHADER_LOC_MATRIX_MVP], MatrixMultiply(MatrixMultiply(matModel, matView), matProjection));
+	}
+
+	void endDraw(const Material& material) {
+		for (int i = 0; i < NUM_MATERIAL_MAPS; i++) {
+			if (material.maps[i].texture.id == 0) continue;
+			rlActiveTextureSlot(i);
+			rlDisableTexture();
+		}
+
+		rlDisableShader();
+	}
+
+	void drawMeshRanges(const Mesh& mesh, const Material& material, Matrix transform, const std::vector<IndexRange>& ranges) {
+		if (ranges.empty()) return;
+		if (mesh.indices == nullptr || mesh.vaoId == 0) {
+			// Without an index buffer or vertex array the ranges can't be addressed, so draw everything
+			DrawMesh(mesh, material, transform);
+			return;
+		}
+
+		beginDraw(material, transform);
+
+		rlEnableVertexArray(mesh.vaoId);
+		for (const IndexRange& range : ranges) {
+			rlDrawVertexArrayElements(range.offset, range.count, 0);
+		}
+		rlDisableVertexArray();
+
+		endDraw(material);
+	}
+
+	void updateNormalLines(std::vector<float>& lines, const float* vertices, const float* normals, int vertexCount, float length) {
+		lines.resize(static_cast<size_t>(vertexCount) * 6);
+		for (int i = 0; i < vertexCount; i++) {
+			const float* vertex = vertices + i * 3;
+			const float* normal = normals + i * 3;
+			float* line = lines.data() + i * 6;
+			for (int j = 0; j < 3; j++) {
+				line[j] = vertex[j];
+				line[3 + j] = vertex[j] + normal[j] * length;
+			}
+		}
+	}
+
+	void drawLines(const std::vector<float>& lines, Matrix transform, Color color) {
+		if (lines.empty()) return;
+
+		// The batch is flushed by rlVertex3f() whenever it is full, so any number of lines can be drawn
+		rlPushMatrix();
+		rlMultMatrixf(MatrixToFloat(transform));
+		rlBegin(RL_LINES);
+		rlColor4ub(color.r, color.g, color.b, color.a);
+		for (size_t i = 0; i + 2 < lines.size(); i += 3) {
+			rlVertex3f(lines[i], lines[i + 1], lines[i + 2]);
+		}
+		rlEnd();
+		rlPopMatrix();
+	}
+
+	void unloadMeshBuffers(Mesh& mesh) {
+		if (mesh.vaoId == 0) return;
+
+		rlUnloadVertexArray(mesh.vaoId);
+		// Buffers past the indices only exist for skinned meshes, the length of vboId depends on the raylib config
+		if (mesh.vboId) {
+			for (int i = 0; i <= RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES; i++) rlUnloadVertexBuffer(mesh.vboId[i]);
+		}
+		RL_FREE(mesh.vboId);
+		mesh.vboId = nullptr;
+		mesh.vaoId = 0;
+	}
+}
\ No newline at end of file
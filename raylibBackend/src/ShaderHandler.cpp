@@ -12,8 +12,18 @@ void ShaderHandler::deactivate() {
 	EndShaderMode();
 }
 
+void ShaderHandler::draw() {}
+
 void ShaderHandler::useShader(Shader shader) {
 	if(shaderSet) UnloadShader(m_shader);
 	m_shader = shader;
 	shaderSet = true;
+}
+
+Shader ShaderHandler::getShader() const {
+	return m_shader;
+}
+
+bool ShaderHandler::hasShader() const {
+	return shaderSet;
 }
\ No newline at end of file
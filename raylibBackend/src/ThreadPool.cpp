@@ -30,6 +30,7 @@ void ThreadPool::initializeThreadRunners(int numberOfThreads) {
 }
 
 void ThreadPool::update(int targetFPS) {
+	std::lock_guard<std::mutex> lock(m_queueMutex);
 	while (!m_tasksQueue.empty() && isAnyThreadAvailable()) {
 		for (int i = 0; i < m_numberOfThreads; i++) {
 			if (m_isFree[i].load()) {
@@ -63,10 +64,20 @@ bool ThreadPool::isAnyThreadAvailable() {
 }
 
 void ThreadPool::addTask(std::function<void()> task, std::atomic<bool>* flag) {
+	std::lock_guard<std::mutex> lock(m_queueMutex);
 	m_tasksQueue.push(task);
 	m_flagsQueue.push(flag);
 }
 
+int ThreadPool::getNumThreads() const {
+	return m_numberOfThreads;
+}
+
+int ThreadPool::getNumQueuedTasks() const {
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	return static_cast<int>(m_tasksQueue.size());
+}
+
 void ThreadPool::ThreadRunner(const std::atomic<bool>* shutdown, const std::function<void()>* task, std::atomic<bool>** returnFlag, std::atomic<bool>* isFree) {
 	while (!shutdown->load()) {
 		isFree->wait(true);
@@ -1,7 +1,7 @@
 #include "DebugGui/TerrainDebugGui.h"
 
 namespace DebugGui {
-	TerrainDebugGui::TerrainDebugGui(std::string name, Terrain::TerrainManager& terrain, GuiManager& guiManager) : Gui(name), m_terrain(terrain), m_settings(*m_terrain.refSettings()), m_guiManager(guiManager), m_drawWired(m_terrain.getDrawWired()), m_drawNormals(m_terrain.getDrawNormals()), m_scale(m_terrain.getScale()), m_tint(m_terrain.getTint()) {}
+	TerrainDebugGui::TerrainDebugGui(std::string name, Terrain::TerrainManager& terrain, GuiManager& guiManager) : Gui(name), m_terrain(terrain), m_settings(*m_terrain.refSettings()), m_guiManager(guiManager), m_drawWired(m_terrain.getDrawWired()), m_drawNormals(m_terrain.getDrawNormals()), m_normalsDistance(m_terrain.getNormalsDistance()), m_frustumCulling(m_terrain.getFrustumCulling()), m_sortFrontToBack(m_terrain.getSortFrontToBack()), m_occlusionCulling(m_terrain.getOcclusionCulling()), m_scale(m_terrain.getScale()), m_tint(m_terrain.getTint()) {}
 
 	bool TerrainDebugGui::render() {
 		ImGui::Begin(m_name.c_str(), &m_open);
@@ -14,6 +14,8 @@ namespace DebugGui {
 		if (ImGui::InputInt("#Width", &m_settings.numWidth)) m_complexChange = true;
 		if (ImGui::InputInt("#Height", &m_settings.numHeight)) m_complexChange = true;
 		if (ImGui::SliderFloat("Spacing", &m_settings.spacing, 0.1f, 10.0f)) m_complexChange = true;
+		if (ImGui::InputInt("Cluster Size", &m_settings.clusterSize)) m_complexChange = true;
+		if (ImGui::Checkbox("Shared Buffer Arena", &m_settings.useBufferArena)) m_complexChange = true;
 		if (ImGui::Button("Open Noise Settings") && !m_openNoiseGui) {
 			m_openNoiseGui = true;
 			m_guiManager.addGui(std::make_unique<NoiseDebugGui>(NoiseDebugGui("" + m_name + " Noise", m_terrain, &m_openNoiseGui)));
@@ -22,28 +24,76 @@ namespace DebugGui {
 		ImGui::SeparatorText("Drawing Settings (Instant)");
 		if (ImGui::Checkbox("Wireframe", &m_drawWired)) m_terrain.setDrawWired(m_drawWired);
 		if(ImGui::Checkbox("Normals", &m_drawNormals)) m_terrain.setDrawNormals(m_drawNormals);
+		if (ImGui::SliderFloat("Normals Distance", &m_normalsDistance, 0.0f, 1000.0f)) m_terrain.setNormalsDistance(m_normalsDistance);
+		if (ImGui::Checkbox("Frustum Culling", &m_frustumCulling)) m_terrain.setFrustumCulling(m_frustumCulling);
+		if (ImGui::Checkbox("Front to Back Sorting", &m_sortFrontToBack)) m_terrain.setSortFrontToBack(m_sortFrontToBack);
+		if (ImGui::Checkbox("Occlusion Culling", &m_occlusionCulling)) m_terrain.setOcclusionCulling(m_occlusionCulling);
+		ImGui::Text("Visible Elements: %i", m_terrain.getNumVisibleElements());
+		ImGui::Text("Culled Elements: %i", m_terrain.getNumCulledElements());
+		ImGui::Text("Occluded Elements: %i", m_terrain.getNumOccludedElements());
+		ImGui::Text("Visible Clusters: %i", m_terrain.getNumVisibleClusters());
+		ImGui::Text("Culled Clusters: %i", m_terrain.getNumCulledClusters());
+		ImGui::Text("Arena Slots: %i in %i pages", m_terrain.getNumArenaSlots(), m_terrain.getNumArenaPages());
+		ImGui::Text("Generation Jobs: %i queued, %i running", m_terrain.getNumPendingGenerations(), m_terrain.getNumRunningGenerations());
+		Terrain::TerrainManager::HashStats hashStats = m_terrain.getManipulationHashStats();
+		ImGui::Text("Diff Buckets: %zu keys in %zu of %zu buckets, fullest %zu", hashStats.numEntries, hashStats.numUsedBuckets, hashStats.numBuckets, hashStats.maxBucketSize);
 		if (ImGui::SliderFloat("Terrain Model Scale", &m_scale, 0.1f, 10.0f)) m_terrain.setScale(m_scale);
 		if (ImGui::ColorEdit4("Tint", (float*)&m_tint)) m_terrain.setTint(m_tint);
 
 		ImGui::SeparatorText("MISC. (Instant)");
 		if (ImGui::Checkbox("Follow Camera", &m_settings.followCamera)) m_settingsChange = true;
 		if (ImGui::Checkbox("Update with ThreadPool", &m_settings.updateWithThreadPool)) m_settingsChange = true;
+		if (ImGui::SliderFloat("Prefetch Time", &m_settings.prefetchTime, 0.0f, 5.0f)) m_settingsChange = true;
+		ImGui::Text("Warm Elements: %i", m_terrain.getNumWarmElements());
+		ImGui::Text("Interest Regions: %i, %i shared elements", m_terrain.getNumInterestRegions(), m_terrain.getNumSharedElements());
+		const Terrain::FrameBudget& frameBudget = m_terrain.getFrameBudget();
+		ImGui::Text("Frame Budget: %.2f of %.2f ms, %.0f of %.0f KB uploaded, %i deferred", frameBudget.getLastWorkTime() * 1000.0f, frameBudget.getWorkTime() * 1000.0f, frameBudget.getLastUploadedBytes() / 1024.0f, frameBudget.getUploadBudget() / 1024.0f, frameBudget.getLastNumDeferred());
+		if (ImGui::Checkbox("Simplify Meshes", &m_settings.simplifyMeshes)) m_settingsChange = true;
+		if (ImGui::SliderFloat("Simplification Error", &m_settings.simplificationError, 0.0f, 2.0f)) m_settingsChange = true;
+		if (ImGui::Checkbox("Normal Maps", &m_settings.useNormalMaps)) m_settingsChange = true;
 
+		ImGui::SeparatorText("Residency");
+		if (ImGui::SliderFloat("GPU Budget (MB)", &m_settings.gpuBudget, 0.0f, 2048.0f)) m_settingsChange = true;
+		if (ImGui::SliderFloat("CPU Budget (MB)", &m_settings.cpuBudget, 0.0f, 4096.0f)) m_simpleChange = true;
+		if (ImGui::SliderFloat("Diff Budget (MB)", &m_settings.diffBudget, 0.0f, 1024.0f)) m_settingsChange = true;
+		if (ImGui::SliderFloat("Pin Distance", &m_settings.pinDistance, 0.0f, 1000.0f)) m_settingsChange = true;
+		Terrain::ResidencyManager::TierStats tierStats = m_terrain.getResidencyStats();
+		ImGui::Text("GPU: %i elements, %.1f MB (%i pinned)", tierStats.numGpuElements, tierStats.gpuBytes / (1024.0f * 1024.0f), tierStats.numPinnedElements);
+		ImGui::Text("CPU: %i elements only, %.1f MB of meshes", tierStats.numCpuElements, tierStats.cpuBytes / (1024.0f * 1024.0f));
+		ImGui::Text("Diffs: %i raw %.1f MB, %i compressed %.1f MB, %i on disk %.1f MB", tierStats.numRawDiffs, tierStats.rawDiffBytes / (1024.0f * 1024.0f), tierStats.numCompressedDiffs, tierStats.compressedDiffBytes / (1024.0f * 1024.0f), tierStats.numDiskDiffs, tierStats.diskDiffBytes / (1024.0f * 1024.0f));
+		ImGui::Text("Resampling Diffs: %i", m_terrain.getNumDiffResamples());
+
+		// The buffer arena is owned by the terrain and may have been replaced since the settings were copied
+		m_settings.bufferArena = m_terrain.refSettings()->bufferArena;
 		if (m_settingsChange) {
-			(*m_terrain.refSettings()) = m_settings;
+			// The grid only changes on Apply, the elements of the terrain read it from the same settings
+			std::shared_ptr<Terrain::terrain_settings> settings = m_terrain.refSettings();
+			Terrain::terrain_settings instantSettings = m_settings;
+			instantSettings.numWidth = settings->numWidth;
+			instantSettings.numHeight = settings->numHeight;
+			instantSettings.spacing = settings->spacing;
+			instantSettings.clusterSize = settings->clusterSize;
+			instantSettings.useBufferArena = settings->useBufferArena;
+			(*settings) = instantSettings;
 			m_settingsChange = false;
 		}
 
 		ImGui::SeparatorText("");
 		if (ImGui::Button("Apply")) {
 			float oldRadius = m_terrain.refSettings()->radius;
-			(*m_terrain.refSettings()) = m_settings;
-			if (m_complexChange) m_terrain.renewTerrain();
-			else if (m_simpleChange) m_terrain.updateTerrain(oldRadius);
+			if (m_complexChange) m_terrain.renewTerrain(m_settings);
+			else {
+				(*m_terrain.refSettings()) = m_settings;
+				if (m_simpleChange) m_terrain.updateTerrain(oldRadius);
+			}
 
 			m_simpleChange = false;
 			m_complexChange = false;
 		}
+		if (m_terrain.isRenewing()) {
+			ImGui::SameLine();
+			ImGui::Text("Generating renewed terrain...");
+		}
 
 		ImGui::End();
 
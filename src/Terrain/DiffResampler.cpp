@@ -0,0 +1,106 @@
+#include "Terrain/DiffResampler.h"
+#include <cmath>
+#include <algorithm>
+
+namespace Terrain {
+	namespace DiffResampler {
+		namespace {
+			// Where a world coordinate lies in the grid of the source layout, the vertex before it and the weight of the vertex after it
+			struct Sample {
+				int cell;
+				int vertex;
+				float weight;
+			};
+
+			Sample getSample(float world, float cellSize, float spacing, int numVertices) {
+				Sample sample;
+				sample.cell = static_cast<int>(std::floor(world / cellSize));
+				float local = (world - sample.cell * cellSize) / spacing;
+				sample.vertex = std::clamp(static_cast<int>(local), 0, numVertices - 2);
+				sample.weight = std::clamp(local - sample.vertex, 0.0f, 1.0f);
+				return sample;
+			}
+
+			// The same position seen from the cell before, only differs from sample if it lies on the first vertex of its cell
+			Sample getBorderSample(const Sample& sample, int numVertices) {
+				if (sample.vertex != 0 || sample.weight != 0.0f) return sample;
+				return { sample.cell - 1, numVertices - 2, 1.0f };
+			}
+
+			// Vertices on the border of a cell exist in both neighbours, so the neighbour is used if the cell itself has no diff
+			const float* findSource(const ResidencyManager::DiffMap& sources, const Layout& from, Sample& column, Sample& row) {
+				Sample columns[2] = { column, getBorderSample(column, from.numWidth) };
+				Sample rows[2] = { row, getBorderSample(row, from.numHeight) };
+				for (const Sample& candidateColumn : columns) {
+					for (const Sample& candidateRow : rows) {
+						ResidencyManager::DiffMap::const_iterator it = sources.find(ElementKey(candidateColumn.cell, candidateRow.cell));
+						if (it == sources.end()) continue;
+
+						column = candidateColumn;
+						row = candidateRow;
+						return it->second.get();
+					}
+				}
+				return nullptr;
+			}
+		} // private namespace
+
+		std::vector<ElementKey> getCoveredKeys(ElementKey key, const Layout& from, const Layout& to) {
+			float fromWidth = (from.numWidth - 1) * from.spacing;
+			float fromHeight = (from.numHeight - 1) * from.spacing;
+			float toWidth = (to.numWidth - 1) * to.spacing;
+			float toHeight = (to.numHeight - 1) * to.spacing;
+
+			// Cells share their border vertices, so a cell ending exactly where the source cell starts still samples it
+			int firstX = static_cast<int>(std::ceil(key.getCellX() * fromWidth / toWidth)) - 1;
+			int lastX = static_cast<int>(std::floor((key.getCellX() + 1) * fromWidth / toWidth));
+			int firstZ = static_cast<int>(std::ceil(key.getCellZ() * fromHeight / toHeight)) - 1;
+			int lastZ = static_cast<int>(std::floor((key.getCellZ() + 1) * fromHeight / toHeight));
+
+			std::vector<ElementKey> keys;
+			for (int cellX = firstX; cellX <= lastX; cellX++) {
+				for (int cellZ = firstZ; cellZ <= lastZ; cellZ++) {
+					keys.push_back(ElementKey(cellX, cellZ));
+				}
+			}
+			return keys;
+		}
+
+		void resample(const ResidencyManager::DiffMap& sources, const Layout& from, ElementKey key, const Layout& to, float* target) {
+			std::fill(target, target + to.numWidth * to.numHeight * 3, 0.0f);
+			if (from.numWidth < 2 || from.numHeight < 2) return;
+
+			float fromWidth = (from.numWidth - 1) * from.spacing;
+			float fromHeight = (from.numHeight - 1) * from.spacing;
+			float originX = key.getCellX() * (to.numWidth - 1) * to.spacing;
+			float originZ = key.getCellZ() * (to.numHeight - 1) * to.spacing;
+
+			// The rows are the same for every column, so they are only placed once
+			std::vector<Sample> rows(to.numHeight);
+			for (int z = 0; z < to.numHeight; z++) {
+				rows[z] = getSample(originZ + z * to.spacing, fromHeight, from.spacing, from.numHeight);
+			}
+
+			for (int x = 0; x < to.numWidth; x++) {
+				Sample column = getSample(originX + x * to.spacing, fromWidth, from.spacing, from.numWidth);
+				for (int z = 0; z < to.numHeight; z++) {
+					Sample sourceColumn = column;
+					Sample row = rows[z];
+					const float* source = findSource(sources, from, sourceColumn, row);
+					if (!source) continue;
+
+					const float* a = source + (sourceColumn.vertex * from.numHeight + row.vertex) * 3;
+					const float* b = a + 3;
+					const float* c = a + from.numHeight * 3;
+					const float* d = c + 3;
+					float* vertex = target + (x * to.numHeight + z) * 3;
+					for (int i = 0; i < 3; i++) {
+						float start = a[i] + (b[i] - a[i]) * row.weight;
+						float end = c[i] + (d[i] - c[i]) * row.weight;
+						vertex[i] = start + (end - start) * sourceColumn.weight;
+					}
+				}
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "Terrain/ElementGrid.h"
+#include <algorithm>
+
+namespace Terrain {
+	namespace {
+		int wrap(int value, int size) {
+			int result = value % size;
+			return result < 0 ? result + size : result;
+		}
+	} // private namespace
+
+	ElementGrid::iterator::iterator(const ElementGrid* grid, int slot) : m_grid(grid), m_slot(slot) {
+		skipEmpty();
+	}
+
+	ManipulableTerrainElement& ElementGrid::iterator::operator*() const {
+		return *m_grid->m_slots[m_slot];
+	}
+
+	ManipulableTerrainElement* ElementGrid::iterator::operator->() const {
+		return m_grid->m_slots[m_slot].get();
+	}
+
+	ElementGrid::iterator& ElementGrid::iterator::operator++() {
+		m_slot++;
+		skipEmpty();
+		return *this;
+	}
+
+	ElementGrid::iterator ElementGrid::iterator::operator++(int) {
+		iterator old = *this;
+		++(*this);
+		return old;
+	}
+
+	bool ElementGrid::iterator::operator==(const iterator& other) const {
+		return m_grid == other.m_grid && m_slot == other.m_slot;
+	}
+
+	bool ElementGrid::iterator::operator!=(const iterator& other) const {
+		return !(*this == other);
+	}
+
+	void ElementGrid::iterator::skipEmpty() {
+		int numSlots = static_cast<int>(m_grid->m_slots.size());
+		while (m_slot < numSlots && !m_grid->m_slots[m_slot]) m_slot++;
+	}
+
+	void ElementGrid::setWindow(int originX, int originZ, int width, int height, std::vector<std::unique_ptr<ManipulableTerrainElement>>& released) {
+		width = std::max(width, 0);
+		height = std::max(height, 0);
+
+		if (width != m_width || height != m_height) {
+			// The slots depend on the size, so every element that stays has to be moved into its new slot
+			std::vector<std::unique_ptr<ManipulableTerrainElement>> oldSlots;
+			oldSlots.swap(m_slots);
+			m_slots.resize(width * height);
+			m_originX = originX;
+			m_originZ = originZ;
+			m_width = width;
+			m_height = height;
+			m_size = 0;
+			for (std::unique_ptr<ManipulableTerrainElement>& element : oldSlots) {
+				if (!element) continue;
+
+				ElementKey key = element->getKey();
+				if (inWindow(key.getCellX(), key.getCellZ())) insert(std::move(element));
+				else released.push_back(std::move(element));
+			}
+			return;
+		}
+
+		// Only the cells of the old window, that are not part of the new one, can hold elements that have to go
+		int oldFirstX = m_originX, oldLastX = m_originX + m_width - 1;
+		int oldFirstZ = m_originZ, oldLastZ = m_originZ + m_height - 1;
+		int newFirstX = originX, newLastX = originX + width - 1;
+		int newFirstZ = originZ, newLastZ = originZ + height - 1;
+		if (newFirstX > oldLastX || newLastX < oldFirstX || newFirstZ > oldLastZ || newLastZ < oldFirstZ) releaseAll(released);
+		else {
+			releaseCells(oldFirstX, std::min(oldLastX, newFirstX - 1), oldFirstZ, oldLastZ, released);
+			releaseCells(std::max(oldFirstX, newLastX + 1), oldLastX, oldFirstZ, oldLastZ, released);
+			int keptFirstX = std::max(oldFirstX, newFirstX), keptLastX = std::min(oldLastX, newLastX);
+			releaseCells(keptFirstX, keptLastX, oldFirstZ, std::min(oldLastZ, newFirstZ - 1), released);
+			releaseCells(keptFirstX, keptLastX, std::max(oldFirstZ, newLastZ + 1), oldLastZ, released);
+		}
+		m_originX = originX;
+		m_originZ = originZ;
+	}
+
+	bool ElementGrid::inWindow(int cellX, int cellZ) const {
+		return cellX >= m_originX && cellX < m_originX + m_width && cellZ >= m_originZ && cellZ < m_originZ + m_height;
+	}
+
+	ManipulableTerrainElement* ElementGrid::get(int cellX, int cellZ) const {
+		if (!inWindow(cellX, cellZ)) return nullptr;
+
+		return m_slots[toSlot(cellX, cellZ)].get();
+	}
+
+	ManipulableTerrainElement* ElementGrid::find(ElementKey key) const {
+		return get(key.getCellX(), key.getCellZ());
+	}
+
+	ManipulableTerrainElement& ElementGrid::insert(std::unique_ptr<ManipulableTerrainElement> element) {
+		ElementKey key = element->getKey();
+		std::unique_ptr<ManipulableTerrainElement>& slot = m_slots[toSlot(key.getCellX(), key.getCellZ())];
+		if (!slot) m_size++;
+		slot = std::move(element);
+		return *slot;
+	}
+
+	std::unique_ptr<ManipulableTerrainElement> ElementGrid::release(int cellX, int cellZ) {
+		if (!inWindow(cellX, cellZ)) return nullptr;
+
+		std::unique_ptr<ManipulableTerrainElement>& slot = m_slots[toSlot(cellX, cellZ)];
+		if (slot) m_size--;
+		return std::move(slot);
+	}
+
+	void ElementGrid::releaseAll(std::vector<std::unique_ptr<ManipulableTerrainElement>>& released) {
+		for (std::unique_ptr<ManipulableTerrainElement>& slot : m_slots) {
+			if (slot) released.push_back(std::move(slot));
+		}
+		m_size = 0;
+	}
+
+	ElementGrid::iterator ElementGrid::begin() const {
+		return iterator(this, 0);
+	}
+
+	ElementGrid::iterator ElementGrid::end() const {
+		return iterator(this, static_cast<int>(m_slots.size()));
+	}
+
+	size_t ElementGrid::size() const {
+		return m_size;
+	}
+
+	bool ElementGrid::empty() const {
+		return m_size == 0;
+	}
+
+	int ElementGrid::getOriginX() const {
+		return m_originX;
+	}
+
+	int ElementGrid::getOriginZ() const {
+		return m_originZ;
+	}
+
+	int ElementGrid::getWidth() const {
+		return m_width;
+	}
+
+	int ElementGrid::getHeight() const {
+		return m_height;
+	}
+
+	int ElementGrid::toSlot(int cellX, int cellZ) const {
+		return wrap(cellX, m_width) + wrap(cellZ, m_height) * m_width;
+	}
+
+	void ElementGrid::releaseCells(int firstX, int lastX, int firstZ, int lastZ, std::vector<std::unique_ptr<ManipulableTerrainElement>>& released) {
+		for (int cellX = firstX; cellX <= lastX; cellX++) {
+			for (int cellZ = firstZ; cellZ <= lastZ; cellZ++) {
+				std::unique_ptr<ManipulableTerrainElement> element = release(cellX, cellZ);
+				if (element) released.push_back(std::move(element));
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "Terrain/FrameBudget.h"
+#include <raylib.h>
+#include <algorithm>
+
+namespace Terrain {
+	void FrameBudget::beginFrame(float frameTime, float targetFrameTime) {
+		// Whatever the last frame spent outside of the terrain will most likely be spent again
+		float otherTime = std::max(0.0f, frameTime - m_lastWorkTime);
+		m_workTime = std::clamp((targetFrameTime - otherTime) * 0.9f, m_minWorkTime, std::max(targetFrameTime, m_minWorkTime));
+
+		if (frameTime > targetFrameTime * 1.05f) m_uploadBudget = std::max(m_minUploadBudget, static_cast<size_t>(m_uploadBudget * 0.7f));
+		else if (m_numDeferred > 0) m_uploadBudget = std::min(m_maxUploadBudget, static_cast<size_t>(m_uploadBudget * 1.25f));
+
+		m_lastUploadedBytes = m_uploadedBytes;
+		m_lastNumDeferred = m_numDeferred;
+		m_uploadedBytes = 0;
+		m_numDeferred = 0;
+		m_frameStart = GetTime();
+	}
+
+	void FrameBudget::endFrame() {
+		m_lastWorkTime = static_cast<float>(GetTime() - m_frameStart);
+	}
+
+	bool FrameBudget::hasTimeLeft() const {
+		return GetTime() - m_frameStart < m_workTime;
+	}
+
+	bool FrameBudget::tryUpload(size_t numBytes) {
+		if (numBytes == 0) return true;
+		if (m_uploadedBytes > 0 && m_uploadedBytes + numBytes > m_uploadBudget) {
+			m_numDeferred++;
+			return false;
+		}
+
+		m_uploadedBytes += numBytes;
+		return true;
+	}
+
+	float FrameBudget::getWorkTime() const {
+		return m_workTime;
+	}
+
+	float FrameBudget::getLastWorkTime() const {
+		return m_lastWorkTime;
+	}
+
+	size_t FrameBudget::getUploadBudget() const {
+		return m_uploadBudget;
+	}
+
+	size_t FrameBudget::getLastUploadedBytes() const {
+		return m_lastUploadedBytes;
+	}
+
+	int FrameBudget::getLastNumDeferred() const {
+		return m_lastNumDeferred;
+	}
+}
\ No newline at end of file
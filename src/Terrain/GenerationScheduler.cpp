@@ -0,0 +1,91 @@
+#include "Terrain/GenerationScheduler.h"
+#include <raymath.h>
+#include <vector>
+#include <algorithm>
+#include <tuple>
+
+namespace Terrain {
+	void GenerationScheduler::schedule(ElementKey key, Vector3 center, std::function<void()> task, bool idle) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending[key] = { center, task, idle };
+	}
+
+	void GenerationScheduler::promote(ElementKey key) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::unordered_map<ElementKey, Job, ElementKeyHash>::iterator it = m_pending.find(key);
+		if (it != m_pending.end()) it->second.idle = false;
+	}
+
+	GenerationScheduler::DoneFlag GenerationScheduler::cancel(ElementKey key) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending.erase(key);
+
+		std::unordered_map<ElementKey, DoneFlag, ElementKeyHash>::iterator it = m_running.find(key);
+		if (it == m_running.end() || it->second->load()) return nullptr;
+		return it->second;
+	}
+
+	void GenerationScheduler::cancelAll() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending.clear();
+	}
+
+	void GenerationScheduler::dispatch(ThreadPool& pool, Vector3 viewPosition, Vector3 viewDirection, int maxQueued) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (std::unordered_map<ElementKey, DoneFlag, ElementKeyHash>::iterator it = m_running.begin(); it != m_running.end();) {
+			if (it->second->load()) it = m_running.erase(it);
+			else it++;
+		}
+
+		int numFree = maxQueued - pool.getNumQueuedTasks();
+		if (numFree <= 0 || m_pending.empty()) return;
+
+		// Priorities change with every step of the viewer, so they are only computed for the jobs that are handed out now
+		std::vector<std::tuple<bool, float, ElementKey>> order;
+		order.reserve(m_pending.size());
+		for (auto& [key, job] : m_pending) {
+			order.push_back({ job.idle, getPriority(job, viewPosition, viewDirection), key });
+		}
+		int numDispatched = std::min(numFree, static_cast<int>(order.size()));
+		std::partial_sort(order.begin(), order.begin() + numDispatched, order.end(), [](const auto& a, const auto& b) {
+			if (std::get<0>(a) != std::get<0>(b)) return std::get<0>(b);
+			return std::get<1>(a) < std::get<1>(b);
+			});
+
+		for (int i = 0; i < numDispatched; i++) {
+			ElementKey key = std::get<2>(order[i]);
+			std::unordered_map<ElementKey, Job, ElementKeyHash>::iterator it = m_pending.find(key);
+			DoneFlag done = std::make_shared<std::atomic<bool>>(false);
+			std::function<void()> task = std::move(it->second.task);
+			m_pending.erase(it);
+			m_running[key] = done;
+
+			pool.addTask([task, done]() {
+				task();
+				done->store(true);
+				}, nullptr);
+		}
+	}
+
+	int GenerationScheduler::getNumPending() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return static_cast<int>(m_pending.size());
+	}
+
+	int GenerationScheduler::getNumRunning() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return static_cast<int>(m_running.size());
+	}
+
+	float GenerationScheduler::getPriority(const Job& job, Vector3 viewPosition, Vector3 viewDirection) const {
+		Vector2 toJob = { job.center.x - viewPosition.x, job.center.z - viewPosition.z };
+		float distance = Vector2Length(toJob);
+		Vector2 direction = Vector2Normalize({ viewDirection.x, viewDirection.z });
+		if (distance <= 0.0f || Vector2Length(direction) <= 0.0f) return distance;
+
+		// Straight ahead keeps the distance, straight behind doubles it
+		float facing = Vector2DotProduct(Vector2Scale(toJob, 1.0f / distance), direction);
+		return distance * (1.5f - 0.5f * facing);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "Terrain/GridKernels.h"
+#include <cmath>
+#include <algorithm>
+
+namespace Terrain {
+	namespace GridKernels {
+		namespace {
+			// Dimensions only known at runtime
+			struct RuntimeDims {
+				int width;
+				int height;
+
+				RuntimeDims(int numWidth, int numHeight) : width(numWidth), height(numHeight) {}
+			};
+
+			// Dimensions known at compile time, the runtime values are ignored
+			template<int W, int H>
+			struct FixedDims {
+				static constexpr int width = W;
+				static constexpr int height = H;
+
+				FixedDims(int, int) {}
+			};
+
+			template<typename Dims>
+			void fillFlatVertices(float* vertices, int numWidth, int numHeight, float spacing) {
+				const Dims dims(numWidth, numHeight);
+				for (int x = 0; x < dims.width; x++) {
+					float* column = vertices + x * dims.height * 3;
+					for (int z = 0; z < dims.height; z++) {
+						column[z * 3] = x * spacing;
+						column[z * 3 + 1] = 0.0f;
+						column[z * 3 + 2] = z * spacing;
+					}
+				}
+			}
+
+			template<typename Dims>
+			void composeHeights(float* heights, const std::vector<Color*>& noiseLayers, const std::vector<Noise::noise_layer_settings>& layerSettings, int numWidth, int numHeight) {
+				const Dims dims(numWidth, numHeight);
+				std::fill(heights, heights + dims.width * dims.height, 0.0f);
+
+				// Same sum Noise::noiseHeight() builds, but layer by layer, so each image is walked once
+				for (size_t i = 0; i < noiseLayers.size(); i++) {
+					const Color* pixels = noiseLayers[i];
+					float offset = layerSettings[i].aroundZero ? 127.5f : 0.0f;
+					float scale = 1.0f / layerSettings[i].verticalScale;
+					for (int x = 0; x < dims.width; x++) {
+						float* column = heights + x * dims.height;
+						for (int z = 0; z < dims.height; z++) {
+							column[z] += (pixels[z * dims.width + x].r - offset) * scale;
+						}
+					}
+				}
+			}
+
+			template<typename Dims>
+			void applyHeights(float* vertices, const float* heights, int numWidth, int numHeight) {
+				const Dims dims(numWidth, numHeight);
+				for (int i = 0; i < dims.width * dims.height; i++) {
+					vertices[i * 3 + 1] = heights[i];
+				}
+			}
+
+			template<typename Dims>
+			void applyDifference(float* vertices, const float* difference, float sign, int numWidth, int numHeight) {
+				const Dims dims(numWidth, numHeight);
+				for (int i = 0; i < dims.width * dims.height * 3; i++) {
+					vertices[i] += sign * difference[i];
+				}
+			}
+
+			template<typename Dims>
+			void computeNormals(const float* vertices, float* normals, int numWidth, int numHeight, int minX, int minZ, int maxX, int maxZ) {
+				const Dims dims(numWidth, numHeight);
+				minX = std::max(minX, 0);
+				minZ = std::max(minZ, 0);
+				maxX = std::min(maxX, dims.width - 1);
+				maxZ = std::min(maxZ, dims.height - 1);
+
+				for (int x = minX; x <= maxX; x++) {
+					// Central differences inside the grid, one sided differences on its border
+					const float* left = vertices + std::max(x - 1, 0) * dims.height * 3;
+					const float* right = vertices + std::min(x + 1, dims.width - 1) * dims.height * 3;
+					const float* column = vertices + x * dims.height * 3;
+					for (int z = minZ; z <= maxZ; z++) {
+						int back = std::max(z - 1, 0) * 3;
+						int front = std::min(z + 1, dims.height - 1) * 3;
+						Vector3 tangentX = { right[z * 3] - left[z * 3], right[z * 3 + 1] - left[z * 3 + 1], right[z * 3 + 2] - left[z * 3 + 2] };
+						Vector3 tangentZ = { column[front] - column[back], column[front + 1] - column[back + 1], column[front + 2] - column[back + 2] };
+
+						// tangentZ x tangentX points up for an undisturbed grid
+						Vector3 normal = {
+							tangentZ.y * tangentX.z - tangentZ.z * tangentX.y,
+							tangentZ.z * tangentX.x - tangentZ.x * tangentX.z,
+							tangentZ.x * tangentX.y - tangentZ.y * tangentX.x
+						};
+						float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+						if (length > 0.0f) {
+							normal.x /= length;
+							normal.y /= length;
+							normal.z /= length;
+						}
+						else normal = { 0.0f, 1.0f, 0.0f };
+
+						float* target = normals + (x * dims.height + z) * 3;
+						target[0] = normal.x;
+						target[1] = normal.y;
+						target[2] = normal.z;
+					}
+				}
+			}
+
+			template<typename Dims>
+			constexpr Kernels makeKernels() {
+				return { fillFlatVertices<Dims>, composeHeights<Dims>, applyHeights<Dims>, applyDifference<Dims>, computeNormals<Dims> };
+			}
+
+			struct DispatchEntry {
+				int size; // The number of vertices along both sides of the grid
+				Kernels kernels;
+			};
+
+			const Kernels genericKernels = makeKernels<RuntimeDims>();
+			const DispatchEntry dispatchTable[] = {
+				{ 33, makeKernels<FixedDims<33, 33>>() },
+				{ 65, makeKernels<FixedDims<65, 65>>() },
+				{ 129, makeKernels<FixedDims<129, 129>>() },
+				{ 257, makeKernels<FixedDims<257, 257>>() }
+			};
+		} // private namespace
+
+		const Kernels& getKernels(int numWidth, int numHeight) {
+			if (numWidth != numHeight) return genericKernels;
+
+			for (const DispatchEntry& entry : dispatchTable) {
+				if (entry.size == numWidth) return entry.kernels;
+			}
+			return genericKernels;
+		}
+
+		bool isSpecialised(int numWidth, int numHeight) {
+			return &getKernels(numWidth, numHeight) != &genericKernels;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "Terrain/HorizonCuller.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+namespace Terrain {
+	namespace {
+		constexpr float TWO_PI = 2.0f * PI;
+	} // private namespace
+
+	HorizonCuller::HorizonCuller(int numBins) : m_numBins(std::max(numBins, 1)), m_horizonSlopes(m_numBins, -FLT_MAX), m_horizonDistances(m_numBins, FLT_MAX) {}
+
+	void HorizonCuller::reset(Vector3 viewPosition) {
+		m_viewPosition = viewPosition;
+		std::fill(m_horizonSlopes.begin(), m_horizonSlopes.end(), -FLT_MAX);
+		std::fill(m_horizonDistances.begin(), m_horizonDistances.end(), FLT_MAX);
+	}
+
+	bool HorizonCuller::isOccluded(BoundingBox box) const {
+		AngularRange range;
+		if (!computeRange(box, range)) return false;
+
+		// The steepest the box can appear is its top at the closest distance (or the farthest one if it lies below the view)
+		float height = box.max.y - m_viewPosition.y;
+		float maxSlope = height / (height >= 0.0f ? range.minDistance : range.maxDistance);
+
+		// Every bin the box touches has to hide it
+		float binSize = TWO_PI / m_numBins;
+		int firstBin = static_cast<int>(std::floor(range.start / binSize));
+		int lastBin = static_cast<int>(std::floor(range.end / binSize));
+		for (int bin = firstBin; bin <= lastBin; bin++) {
+			int index = toBin(bin);
+			if (m_horizonDistances[index] > range.minDistance || m_horizonSlopes[index] <= maxSlope) return false;
+		}
+
+		return true;
+	}
+
+	void HorizonCuller::addOccluder(BoundingBox box) {
+		AngularRange range;
+		if (!computeRange(box, range)) return;
+
+		// Terrain covers the whole footprint at least at the box minimum, take the flattest slope that height can appear at
+		float height = box.min.y - m_viewPosition.y;
+		float minSlope = height / (height >= 0.0f ? range.maxDistance : range.minDistance);
+
+		// Only bins completely inside the range are guaranteed to be blocked along every ray
+		float binSize = TWO_PI / m_numBins;
+		int firstBin = static_cast<int>(std::ceil(range.start / binSize));
+		int lastBin = static_cast<int>(std::floor(range.end / binSize)) - 1;
+		for (int bin = firstBin; bin <= lastBin; bin++) {
+			int index = toBin(bin);
+			if (minSlope <= m_horizonSlopes[index]) continue;
+
+			m_horizonSlopes[index] = minSlope;
+			m_horizonDistances[index] = m_horizonDistances[index] == FLT_MAX ? range.maxDistance : std::max(m_horizonDistances[index], range.maxDistance);
+		}
+	}
+
+	int HorizonCuller::getNumBins() const {
+		return m_numBins;
+	}
+
+	bool HorizonCuller::computeRange(BoundingBox box, AngularRange& range) const {
+		// Boxes around the view position cover every direction and can neither be culled nor be used as occluder
+		if (m_viewPosition.x >= box.min.x && m_viewPosition.x <= box.max.x && m_viewPosition.z >= box.min.z && m_viewPosition.z <= box.max.z) return false;
+
+		float dx = std::max({ box.min.x - m_viewPosition.x, 0.0f, m_viewPosition.x - box.max.x });
+		float dz = std::max({ box.min.z - m_viewPosition.z, 0.0f, m_viewPosition.z - box.max.z });
+		range.minDistance = std::sqrt(dx * dx + dz * dz);
+		if (range.minDistance <= 0.0f) return false;
+
+		// A box outside of the view position spans less than half a turn, so the corners are measured relative to its center
+		float centerAngle = std::atan2((box.min.z + box.max.z) / 2.0f - m_viewPosition.z, (box.min.x + box.max.x) / 2.0f - m_viewPosition.x);
+		float minAngle = 0.0f;
+		float maxAngle = 0.0f;
+		range.maxDistance = 0.0f;
+		float cornersX[2] = { box.min.x, box.max.x };
+		float cornersZ[2] = { box.min.z, box.max.z };
+		for (float x : cornersX) {
+			for (float z : cornersZ) {
+				float cornerX = x - m_viewPosition.x;
+				float cornerZ = z - m_viewPosition.z;
+				float angle = std::remainder(std::atan2(cornerZ, cornerX) - centerAngle, TWO_PI);
+				minAngle = std::min(minAngle, angle);
+				maxAngle = std::max(maxAngle, angle);
+				range.maxDistance = std::max(range.maxDistance, std::sqrt(cornerX * cornerX + cornerZ * cornerZ));
+			}
+		}
+
+		range.start = centerAngle + minAngle;
+		range.end = centerAngle + maxAngle;
+		return true;
+	}
+
+	int HorizonCuller::toBin(int bin) const {
+		return ((bin % m_numBins) + m_numBins) % m_numBins;
+	}
+}
\ No newline at end of file
@@ -9,7 +9,7 @@ namespace Terrain {
 		}
 	}
 
-	ManipulableTerrainElement::ManipulableTerrainElement(std::shared_ptr<terrain_settings> settings, PositionIdentifier posId, std::shared_ptr<float[]> heightDifference) : TerrainElement(settings, posId), m_difference(heightDifference) {
+	ManipulableTerrainElement::ManipulableTerrainElement(std::shared_ptr<terrain_settings> settings, ElementKey key, std::shared_ptr<float[]> heightDifference) : TerrainElement(settings, key), m_difference(heightDifference) {
 		// If a m_difference pointer is given here, then there is no preexisiting difference, so initialise it
 		// If there already is a difference that should be respected, give a nullptr here and then call loadDifference() with difference array
 		if (m_difference != nullptr) {
@@ -17,19 +17,6 @@ namespace Terrain {
 		}
 	}
 
-	ManipulableTerrainElement::ManipulableTerrainElement(PositionIdentifier posId) : TerrainElement(posId) {
-	}
-
-	ManipulableTerrainElement::ManipulableTerrainElement(const TerrainElement& other) : TerrainElement(other) {
-	}
-
-	ManipulableTerrainElement::ManipulableTerrainElement(const ManipulableTerrainElement& other) : TerrainElement(other) {
-		m_difference = other.m_difference;
-		for (int i = 0; i < settings->numWidth * settings->numHeight * 3; i++) {
-			m_mesh.vertices[i] += m_difference[i];
-		}
-	}
-
 	void ManipulableTerrainElement::initialiseDifference() {
 		for (int i = 0; i < settings->numWidth * settings->numHeight * 3; i++) {
 			m_difference[i] = 0.0f;
@@ -40,9 +27,9 @@ namespace Terrain {
 		if (m_difference) clearDifference();
 
 		m_difference = heightDifference;
-		for (int i = 0; i < settings->numWidth * settings->numHeight * 3; i++) {
-			m_mesh.vertices[i] += m_difference[i];
-		}
+		markBoundsDirty();
+		m_kernels->applyDifference(m_mesh.vertices, m_difference.get(), 1.0f, settings->numWidth, settings->numHeight);
+		updateNormals();
 
 		reloadMeshData();
 		m_hasDifference = true;
@@ -53,38 +40,42 @@ namespace Terrain {
 		if (indices.startIndex == -1) return;
 
 		// TraceLog(LOG_INFO, "start index: %i, width: %i, height: %i", indices.startIndex, indices.width, indices.height);
-		Vector2 vertexPos = { m_mesh.vertices[indices.startIndex * 3] - m_position.x, m_mesh.vertices[indices.startIndex * 3 + 2] - m_position.z };
+		Vector2 vertexPos = { m_mesh.vertices[indices.startIndex * 3], m_mesh.vertices[indices.startIndex * 3 + 2] };
 		int index = indices.startIndex * 3;
-		for (int x = 0; x < indices.width; x++, index += (settings->numHeight - indices.height) * 3, vertexPos.x += settings->spacing, vertexPos.y = m_mesh.vertices[indices.startIndex * 3 + 2] - m_position.z) {
+		for (int x = 0; x < indices.width; x++, index += (settings->numHeight - indices.height) * 3, vertexPos.x += settings->spacing, vertexPos.y = m_mesh.vertices[indices.startIndex * 3 + 2]) {
 			for (int z = 0; z < indices.height; z++, index += 3, vertexPos.y += settings->spacing) {
 				float strengthFactor = manipulationStrength(form, radius, { relativePosition.x, relativePosition.z }, vertexPos);
 				manipulateVertex(dir, type, strengthFactor, strength, index);
 			}
 		}
+		int startX = indices.startIndex / settings->numHeight;
+		int startZ = indices.startIndex % settings->numHeight;
+		markBoundsDirty(startX, startZ, startX + indices.width - 1, startZ + indices.height - 1);
+		updateNormals(startX - 1, startZ - 1, startX + indices.width, startZ + indices.height); // The normals next to the changed vertices depend on them as well
 
 		reloadMeshData();
 		m_hasDifference = true;
 	}
 
 	void ManipulableTerrainElement::removeDifference() {
-		for (int i = 0; i < settings->numWidth * settings->numHeight * 3; i++) {
-			m_mesh.vertices[i] -= m_difference[i];
-		}
+		markBoundsDirty();
+		m_kernels->applyDifference(m_mesh.vertices, m_difference.get(), -1.0f, settings->numWidth, settings->numHeight);
+		updateNormals();
 
 		reloadMeshData();
 	}
 
 	void ManipulableTerrainElement::addDifference() {
-		for (int i = 0; i < settings->numWidth * settings->numHeight * 3; i++) {
-			m_mesh.vertices[i] += m_difference[i];
-		}
+		markBoundsDirty();
+		m_kernels->applyDifference(m_mesh.vertices, m_difference.get(), 1.0f, settings->numWidth, settings->numHeight);
+		updateNormals();
 
 		reloadMeshData();
 	}
 
 	void ManipulableTerrainElement::clearDifference() {
 		initialiseDifference();
-		randomizeTerrain();
+		restoreBaseHeights();
 		updateNormals();
 		reloadMeshData();
 		m_hasDifference = false;
@@ -0,0 +1,110 @@
+#include "Terrain/MeshSimplifier.h"
+#include <vector>
+#include <cmath>
+
+namespace Terrain {
+	namespace MeshSimplifier {
+		namespace {
+			/*
+			* Checks if every vertex of the block lies within maxError of the two triangles that would replace the block
+			* The triangles are (x0|z0, x0|z1, x1|z0) and (x0|z1, x1|z1, x1|z0), the same winding as the full grid uses
+			*/
+			bool isBlockFlat(const float* vertices, int numHeight, int x0, int z0, int x1, int z1, float maxError) {
+				const float* a = vertices + (x0 * numHeight + z0) * 3;
+				const float* b = vertices + (x0 * numHeight + z1) * 3;
+				const float* c = vertices + (x1 * numHeight + z0) * 3;
+				const float* d = vertices + (x1 * numHeight + z1) * 3;
+
+				for (int x = x0; x <= x1; x++) {
+					float u = static_cast<float>(x - x0) / (x1 - x0);
+					for (int z = z0; z <= z1; z++) {
+						float w = static_cast<float>(z - z0) / (z1 - z0);
+						const float* vertex = vertices + (x * numHeight + z) * 3;
+						for (int i = 0; i < 3; i++) {
+							float expected;
+							if (u + w <= 1.0f) expected = a[i] + u * (c[i] - a[i]) + w * (b[i] - a[i]);
+							else expected = d[i] + (1.0f - u) * (b[i] - d[i]) + (1.0f - w) * (c[i] - d[i]);
+							if (std::fabs(vertex[i] - expected) > maxError) return false;
+						}
+					}
+				}
+
+				return true;
+			}
+
+			/*
+			* Recursively splits the block of quads in half until it is flat enough to be drawn with two triangles
+			* Neighbouring blocks of different sizes create T-junctions, but the resulting gaps are bound by maxError
+			*/
+			void simplifyBlock(const float* vertices, int numHeight, int x0, int z0, int x1, int z1, float maxError, std::vector<int>& triangles) {
+				bool singleQuad = (x1 - x0 == 1) && (z1 - z0 == 1);
+				if (singleQuad || isBlockFlat(vertices, numHeight, x0, z0, x1, z1, maxError)) {
+					int a = x0 * numHeight + z0;
+					int b = x0 * numHeight + z1;
+					int c = x1 * numHeight + z0;
+					int d = x1 * numHeight + z1;
+					triangles.insert(triangles.end(), { a, b, c, b, d, c });
+					return;
+				}
+
+				int xMid = (x0 + x1) / 2;
+				int zMid = (z0 + z1) / 2;
+				if (x1 - x0 > 1 && z1 - z0 > 1) {
+					simplifyBlock(vertices, numHeight, x0, z0, xMid, zMid, maxError, triangles);
+					simplifyBlock(vertices, numHeight, x0, zMid, xMid, z1, maxError, triangles);
+					simplifyBlock(vertices, numHeight, xMid, z0, x1, zMid, maxError, triangles);
+					simplifyBlock(vertices, numHeight, xMid, zMid, x1, z1, maxError, triangles);
+				}
+				else if (x1 - x0 > 1) {
+					simplifyBlock(vertices, numHeight, x0, z0, xMid, z1, maxError, triangles);
+					simplifyBlock(vertices, numHeight, xMid, z0, x1, z1, maxError, triangles);
+				}
+				else {
+					simplifyBlock(vertices, numHeight, x0, z0, x1, zMid, maxError, triangles);
+					simplifyBlock(vertices, numHeight, x0, zMid, x1, z1, maxError, triangles);
+				}
+			}
+		} // private namespace
+
+		Mesh simplifyGrid(const float* vertices, const float* normals, int numWidth, int numHeight, float maxError) {
+			std::vector<int> triangles;
+			simplifyBlock(vertices, numHeight, 0, 0, numWidth - 1, numHeight - 1, maxError, triangles);
+
+			// Only keep the vertices that are still referenced and remap the indices onto them
+			int numGridVertices = numWidth * numHeight;
+			std::vector<int> remap(numGridVertices, -1);
+			int vertexCount = 0;
+			for (int index : triangles) {
+				if (remap[index] == -1) remap[index] = vertexCount++;
+			}
+
+			Mesh mesh = { 0 };
+			mesh.vertexCount = vertexCount;
+			mesh.triangleCount = static_cast<int>(triangles.size() / 3);
+			mesh.vertices = (float*)RL_MALLOC(vertexCount * 3 * sizeof(float));
+			mesh.normals = (float*)RL_MALLOC(vertexCount * 3 * sizeof(float));
+			mesh.texcoords = (float*)RL_MALLOC(vertexCount * 2 * sizeof(float));
+			mesh.indices = (unsigned short*)RL_MALLOC(triangles.size() * sizeof(unsigned short));
+
+			for (int i = 0; i < numGridVertices; i++) {
+				int newIndex = remap[i];
+				if (newIndex == -1) continue;
+
+				for (int j = 0; j < 3; j++) {
+					mesh.vertices[newIndex * 3 + j] = vertices[i * 3 + j];
+					mesh.normals[newIndex * 3 + j] = normals ? normals[i * 3 + j] : (j == 1 ? 1.0f : 0.0f);
+				}
+				mesh.texcoords[newIndex * 2] = static_cast<float>(i / numHeight) / (numWidth - 1);
+				mesh.texcoords[newIndex * 2 + 1] = static_cast<float>(i % numHeight) / (numHeight - 1);
+			}
+
+			for (size_t i = 0; i < triangles.size(); i++) {
+				mesh.indices[i] = static_cast<unsigned short>(remap[triangles[i]]);
+			}
+
+			TraceLog(LOG_DEBUG, "MeshSimplifier: Reduced grid from %i to %i triangles", (numWidth - 1) * (numHeight - 1) * 2, mesh.triangleCount);
+
+			return mesh;
+		}
+	}
+}
\ No newline at end of file
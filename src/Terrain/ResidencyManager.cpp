@@ -0,0 +1,316 @@
+#include "Terrain/ResidencyManager.h"
+#include <raymath.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+namespace Terrain {
+	namespace {
+		void appendBytes(std::vector<unsigned char>& data, const void* src, size_t numBytes) {
+			const unsigned char* bytes = static_cast<const unsigned char*>(src);
+			data.insert(data.end(), bytes, bytes + numBytes);
+		}
+	} // private namespace
+
+	ResidencyManager::ResidencyManager(std::string cacheDirectory) : m_cacheDirectory(cacheDirectory) {}
+
+	ResidencyManager::~ResidencyManager() {
+		clear();
+	}
+
+	void ResidencyManager::updateElements(const std::vector<ManipulableTerrainElement*>& elements, Vector3 viewPosition, size_t gpuBudget, float pinDistance) {
+		std::vector<std::pair<float, ManipulableTerrainElement*>> sortedElements;
+		sortedElements.reserve(elements.size());
+		for (ManipulableTerrainElement* element : elements) {
+			BoundingBox box = element->getBoundingBox();
+			Vector3 center = Vector3Add(element->getPosition(), Vector3Scale(Vector3Add(box.min, box.max), 0.5f));
+			sortedElements.push_back({ Vector2Distance({ center.x, center.z }, { viewPosition.x, viewPosition.z }), element });
+		}
+		std::sort(sortedElements.begin(), sortedElements.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+		// Once one element does not fit anymore every farther one is demoted too, so elements of different sizes don't flicker in and out
+		TierStats stats;
+		size_t usedBytes = 0;
+		bool full = false;
+		for (auto& [distance, element] : sortedElements) {
+			size_t bytes = element->getGpuBytes();
+			bool pinned = element->getHasDifference() && distance <= pinDistance;
+			full = full || (gpuBudget != 0 && usedBytes + bytes > gpuBudget);
+			if (!full || pinned) {
+				usedBytes += bytes;
+				if (pinned) stats.numPinnedElements++;
+				if (!element->isGpuResident()) element->getUploadFlag()->store(true);
+				stats.numGpuElements++;
+				stats.gpuBytes += bytes;
+			}
+			else {
+				element->getUploadFlag()->store(false);
+				element->releaseGpuData();
+				stats.numCpuElements++;
+			}
+			stats.cpuBytes += element->getCpuBytes();
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.numGpuElements = stats.numGpuElements;
+		m_stats.gpuBytes = stats.gpuBytes;
+		m_stats.numCpuElements = stats.numCpuElements;
+		m_stats.cpuBytes = stats.cpuBytes;
+		m_stats.numPinnedElements = stats.numPinnedElements;
+	}
+
+	void ResidencyManager::updateDiffs(DiffMap& diffs, Vector3 viewPosition, float cellWidth, float cellHeight, size_t diffSize, size_t diffBudget) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto getDistance = [viewPosition, cellWidth, cellHeight](ElementKey key) {
+			Vector2 cellCenter = { (key.getCellX() + 0.5f) * cellWidth, (key.getCellZ() + 0.5f) * cellHeight };
+			return Vector2Distance(cellCenter, { viewPosition.x, viewPosition.z });
+			};
+
+		// Diffs still held by an element have to stay raw, the others are demoted farthest first
+		size_t rawBytes = diffSize * sizeof(float);
+		size_t usedBytes = 0;
+		m_stats.numRawDiffs = 0;
+		std::vector<std::pair<float, ElementKey>> candidates;
+		for (DiffMap::iterator it = diffs.begin(); it != diffs.end();) {
+			if (it->second.use_count() > 1) {
+				usedBytes += rawBytes;
+				m_stats.numRawDiffs++;
+				it++;
+			}
+			else if (std::isnan(it->second[0])) it = diffs.erase(it);
+			else {
+				candidates.push_back({ getDistance(it->first), it->first });
+				it++;
+			}
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+		for (auto& [distance, key] : candidates) {
+			if (diffBudget == 0 || usedBytes + rawBytes <= diffBudget) {
+				usedBytes += rawBytes;
+				m_stats.numRawDiffs++;
+				continue;
+			}
+
+			DiffMap::iterator it = diffs.find(key);
+			m_compressedDiffs[key] = compress(it->second.get(), diffSize);
+			diffs.erase(it);
+		}
+		m_stats.rawDiffBytes = m_stats.numRawDiffs * rawBytes;
+
+		// Whatever does not fit compressed either is written to disk, again farthest first
+		candidates.clear();
+		for (auto& [key, data] : m_compressedDiffs) {
+			candidates.push_back({ getDistance(key), key });
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+		m_stats.numCompressedDiffs = 0;
+		m_stats.compressedDiffBytes = 0;
+		for (auto& [distance, key] : candidates) {
+			std::vector<unsigned char>& data = m_compressedDiffs[key];
+			if (diffBudget == 0 || usedBytes + data.size() <= diffBudget || !writeToDisk(key, data)) {
+				usedBytes += data.size();
+				m_stats.numCompressedDiffs++;
+				m_stats.compressedDiffBytes += data.size();
+				continue;
+			}
+
+			m_stats.numDiskDiffs++;
+			m_stats.diskDiffBytes += data.size();
+			m_compressedDiffs.erase(key);
+		}
+	}
+
+	bool ResidencyManager::restoreDiff(ElementKey key, DiffMap& diffs) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		std::vector<unsigned char> data;
+		auto compressed = m_compressedDiffs.find(key);
+		auto stored = m_diskDiffs.find(key);
+		if (compressed != m_compressedDiffs.end()) {
+			data = std::move(compressed->second);
+			m_compressedDiffs.erase(compressed);
+			m_stats.numCompressedDiffs--;
+			m_stats.compressedDiffBytes -= data.size();
+		}
+		else if (stored != m_diskDiffs.end()) {
+			data = readFromDisk(key);
+			std::filesystem::remove(getDiffPath(key));
+			m_diskDiffs.erase(stored);
+			m_stats.numDiskDiffs--;
+			m_stats.diskDiffBytes -= data.size();
+		}
+		else return false;
+
+		std::vector<float> diff = decompress(data);
+		float* restored = new float[diff.size()];
+		std::copy(diff.begin(), diff.end(), restored);
+		diffs[key] = std::shared_ptr<float[]>(restored, std::default_delete<float[]>());
+		m_stats.numRawDiffs++;
+		m_stats.rawDiffBytes += diff.size() * sizeof(float);
+		return true;
+	}
+
+	void ResidencyManager::forEachStoredDiff(const std::function<void(ElementKey key, const std::vector<float>& diff)>& func) const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (auto& [key, data] : m_compressedDiffs) {
+			func(key, decompress(data));
+		}
+		for (auto& [key, size] : m_diskDiffs) {
+			func(key, decompress(readFromDisk(key)));
+		}
+	}
+
+	std::vector<std::pair<ElementKey, ResidencyManager::StoredDiff>> ResidencyManager::takeStoredDiffs() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		std::vector<std::pair<ElementKey, StoredDiff>> taken;
+		taken.reserve(m_compressedDiffs.size() + m_diskDiffs.size());
+		for (auto& [key, data] : m_compressedDiffs) {
+			taken.push_back({ key, { std::move(data), "" } });
+		}
+		for (auto& [key, size] : m_diskDiffs) {
+			std::string path = getDiffPath(key) + ".taken" + std::to_string(m_numTakenFiles++);
+			std::error_code error;
+			std::filesystem::rename(getDiffPath(key), path, error);
+			if (error) {
+				TraceLog(LOG_WARNING, "ResidencyManager: Could not move diff to %s", path.c_str());
+				continue;
+			}
+			taken.push_back({ key, { {}, path } });
+		}
+		m_compressedDiffs.clear();
+		m_diskDiffs.clear();
+		m_stats.numCompressedDiffs = 0;
+		m_stats.compressedDiffBytes = 0;
+		m_stats.numDiskDiffs = 0;
+		m_stats.diskDiffBytes = 0;
+		return taken;
+	}
+
+	std::vector<float> ResidencyManager::decodeDiff(const StoredDiff& diff) {
+		if (diff.path.empty()) return decompress(diff.data);
+
+		std::vector<unsigned char> data;
+		{
+			std::ifstream file(diff.path, std::ios::binary);
+			if (!file) {
+				TraceLog(LOG_WARNING, "ResidencyManager: Could not read diff from %s", diff.path.c_str());
+				return {};
+			}
+			data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+		std::error_code error;
+		std::filesystem::remove(diff.path, error);
+		return decompress(data);
+	}
+
+	void ResidencyManager::clear() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (auto& [key, size] : m_diskDiffs) {
+			std::error_code error;
+			std::filesystem::remove(getDiffPath(key), error);
+		}
+		m_compressedDiffs.clear();
+		m_diskDiffs.clear();
+		m_stats.numCompressedDiffs = 0;
+		m_stats.compressedDiffBytes = 0;
+		m_stats.numDiskDiffs = 0;
+		m_stats.diskDiffBytes = 0;
+	}
+
+	unsigned int ResidencyManager::getMaxElements(size_t cpuBudget, int numWidth, int numHeight) {
+		if (cpuBudget == 0) return UINT_MAX;
+
+		// Vertices, normals and the base heights are kept for every element, the texcoords only until the upload
+		size_t elementBytes = static_cast<size_t>(numWidth) * numHeight * 7 * sizeof(float);
+		return static_cast<unsigned int>(std::max<size_t>(1, cpuBudget / elementBytes));
+	}
+
+	ResidencyManager::TierStats ResidencyManager::getStats() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+
+	std::string ResidencyManager::getDiffPath(ElementKey key) const {
+		return m_cacheDirectory + "/x" + std::to_string(key.getCellX()) + "z" + std::to_string(key.getCellZ()) + ".diff";
+	}
+
+	std::vector<unsigned char> ResidencyManager::compress(const float* diff, size_t size) {
+		// Edits only cover parts of an element, so the diff is stored as runs of zeros followed by runs of edited floats
+		std::vector<unsigned char> data;
+		uint32_t count = static_cast<uint32_t>(size);
+		appendBytes(data, &count, sizeof(count));
+		size_t i = 0;
+		while (i < size) {
+			uint32_t numZeros = 0;
+			while (i < size && diff[i] == 0.0f) {
+				numZeros++;
+				i++;
+			}
+			size_t start = i;
+			while (i < size && diff[i] != 0.0f) i++;
+			uint32_t numLiterals = static_cast<uint32_t>(i - start);
+
+			appendBytes(data, &numZeros, sizeof(numZeros));
+			appendBytes(data, &numLiterals, sizeof(numLiterals));
+			appendBytes(data, diff + start, numLiterals * sizeof(float));
+		}
+		return data;
+	}
+
+	std::vector<float> ResidencyManager::decompress(const std::vector<unsigned char>& data) {
+		if (data.size() < sizeof(uint32_t)) return {};
+
+		uint32_t count;
+		std::memcpy(&count, data.data(), sizeof(count));
+		std::vector<float> diff(count, 0.0f);
+		size_t offset = sizeof(count);
+		size_t index = 0;
+		while (offset + 2 * sizeof(uint32_t) <= data.size()) {
+			uint32_t numZeros, numLiterals;
+			std::memcpy(&numZeros, data.data() + offset, sizeof(numZeros));
+			std::memcpy(&numLiterals, data.data() + offset + sizeof(numZeros), sizeof(numLiterals));
+			offset += 2 * sizeof(uint32_t);
+			index += numZeros;
+			if (index + numLiterals > count || offset + numLiterals * sizeof(float) > data.size()) break;
+
+			std::memcpy(diff.data() + index, data.data() + offset, numLiterals * sizeof(float));
+			index += numLiterals;
+			offset += numLiterals * sizeof(float);
+		}
+		return diff;
+	}
+
+	bool ResidencyManager::writeToDisk(ElementKey key, const std::vector<unsigned char>& data) {
+		std::error_code error;
+		std::filesystem::create_directories(m_cacheDirectory, error);
+		std::ofstream file(getDiffPath(key), std::ios::binary | std::ios::trunc);
+		if (!file) {
+			TraceLog(LOG_WARNING, "ResidencyManager: Could not write diff to %s", getDiffPath(key).c_str());
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		m_diskDiffs[key] = data.size();
+		return true;
+	}
+
+	std::vector<unsigned char> ResidencyManager::readFromDisk(ElementKey key) const {
+		std::ifstream file(getDiffPath(key), std::ios::binary);
+		if (!file) {
+			TraceLog(LOG_WARNING, "ResidencyManager: Could not read diff from %s", getDiffPath(key).c_str());
+			return {};
+		}
+
+		return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+}
\ No newline at end of file
@@ -1,28 +1,27 @@
 #include "Terrain/TerrainElement.h"
+#include "Terrain/MeshSimplifier.h"
+#include "MeshRenderer.h"
 #include <chrono>
+#include <cfloat>
+#include <map>
+#include <tuple>
 
 namespace Terrain {
-	Vector3 TerrainElement::getPositionFromPosId() {
-		float xSize = (settings->numWidth - 1) * settings->spacing;
-		float xPos = posId.x * xSize * posId.i + xSize * std::min(0, posId.i);
+	namespace {
+		std::mutex sharedIndicesMutex; // Guards sharedIndices, since elements are initialised by worker threads
+		std::map<std::tuple<int, int, int>, std::weak_ptr<std::vector<unsigned short>>> sharedIndices; // Index buffers by grid width, height and cluster size
+		std::atomic<unsigned int> nextId{ 0 }; // The id the next element gets
+	} // private namespace
 
+	Vector3 TerrainElement::getPositionFromKey() {
+		float xSize = (settings->numWidth - 1) * settings->spacing;
 		float zSize = (settings->numHeight - 1) * settings->spacing;
-		float zPos = posId.z * zSize * posId.n + zSize * std::min(0, posId.n);
 
-		return { xPos, 0., zPos };
+		return { key.getCellX() * xSize, 0.0f, key.getCellZ() * zSize };
 	}
 
 	void TerrainElement::flatTerrainVertices() {
-		int index = 0;
-		for (int x = 0; x < settings->numWidth; x++) {
-			for (int z = 0; z < settings->numHeight; z++) {
-				m_mesh.vertices[index] = static_cast<float>(x * settings->spacing) + m_position.x;
-				m_mesh.vertices[index + 1] = m_position.y;
-				m_mesh.vertices[index + 2] = static_cast<float>(z * settings->spacing) + m_position.z;
-
-				index += 3;
-			}
-		}
+		m_kernels->fillFlatVertices(m_mesh.vertices, settings->numWidth, settings->numHeight, settings->spacing);
 	}
 
 	void TerrainElement::flatTerrainTexcoords() {
@@ -50,21 +49,124 @@ namespace Terrain {
 	}
 
 	void TerrainElement::flatTerrainIndices() {
-		int index = 0;
-		int loopIterations = ((settings->numWidth - 1) * (settings->numHeight - 1)) + (settings->numWidth - 1);
-		for (int i = 0; i < loopIterations; i++) {
-			if ((i + 1) % settings->numHeight == 0) continue;
+		// Every element with the same grid and cluster layout has the same indices, so they are shared instead of being kept per element
+		std::tuple<int, int, int> key = { settings->numWidth, settings->numHeight, settings->clusterSize };
+		std::lock_guard<std::mutex> lock(sharedIndicesMutex);
+		std::shared_ptr<std::vector<unsigned short>> indices = sharedIndices[key].lock();
+		if (!indices) {
+			indices = std::make_shared<std::vector<unsigned short>>(m_mesh.triangleCount * 3);
+
+			// Indices are written cluster by cluster, so that every cluster can be drawn as one range of the index buffer
+			for (const Cluster& cluster : m_clusters) {
+				int index = cluster.indexOffset;
+				for (int x = cluster.startX; x < cluster.endX; x++) {
+					for (int z = cluster.startZ; z < cluster.endZ; z++) {
+						int i = x * settings->numHeight + z;
+
+						(*indices)[index] = i;
+						(*indices)[index + 1] = i + 1;
+						(*indices)[index + 2] = i + settings->numHeight;
+
+						(*indices)[index + 3] = i + 1;
+						(*indices)[index + 4] = i + settings->numHeight + 1;
+						(*indices)[index + 5] = i + settings->numHeight;
+
+						index += 6;
+					}
+				}
+			}
+			sharedIndices[key] = indices;
+		}
 
-			m_mesh.indices[index] = i;
-			m_mesh.indices[index + 1] = i + 1;
-			m_mesh.indices[index + 2] = i + settings->numHeight;
+		m_sharedIndices = indices;
+		m_mesh.indices = m_sharedIndices->data();
+	}
 
-			m_mesh.indices[index + 3] = i + 1;
-			m_mesh.indices[index + 4] = i + settings->numHeight + 1;
-			m_mesh.indices[index + 5] = i + settings->numHeight;
+	void TerrainElement::initialiseClusters() {
+		int clusterSize = std::max(1, settings->clusterSize);
+		int indexOffset = 0;
+
+		m_clusters.clear();
+		for (int startX = 0; startX < settings->numWidth - 1; startX += clusterSize) {
+			int endX = std::min(startX + clusterSize, settings->numWidth - 1);
+			for (int startZ = 0; startZ < settings->numHeight - 1; startZ += clusterSize) {
+				int endZ = std::min(startZ + clusterSize, settings->numHeight - 1);
+				int indexCount = (endX - startX) * (endZ - startZ) * 6;
+				m_clusters.push_back({ { 0 }, indexOffset, indexCount, startX, startZ, endX, endZ });
+				indexOffset += indexCount;
+			}
+		}
+	}
 
-			index += 6;
+	void TerrainElement::updateClusterBounds() {
+		for (Cluster& cluster : m_clusters) {
+			updateClusterBounds(cluster);
 		}
+		updateElementBounds();
+
+		m_boundsDirty = false;
+		m_regionDirty = false;
+	}
+
+	void TerrainElement::updateClusterBounds(Cluster& cluster) {
+		Vector3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (int x = cluster.startX; x <= cluster.endX; x++) {
+			for (int z = cluster.startZ; z <= cluster.endZ; z++) {
+				const float* vertex = m_mesh.vertices + (x * settings->numHeight + z) * 3;
+				Vector3 position = { vertex[0], vertex[1], vertex[2] };
+				min = Vector3Min(min, position);
+				max = Vector3Max(max, position);
+			}
+		}
+		cluster.boundingBox = { min, max };
+	}
+
+	void TerrainElement::updateDirtyBounds() {
+		if (m_boundsDirty) {
+			updateClusterBounds();
+			return;
+		}
+		if (!m_regionDirty) return;
+
+		// Only clusters sharing vertices with the changed region can have different extremes
+		for (Cluster& cluster : m_clusters) {
+			if (cluster.endX < m_dirtyMinX || cluster.startX > m_dirtyMaxX || cluster.endZ < m_dirtyMinZ || cluster.startZ > m_dirtyMaxZ) continue;
+			updateClusterBounds(cluster);
+		}
+		updateElementBounds();
+
+		m_regionDirty = false;
+	}
+
+	void TerrainElement::updateElementBounds() {
+		Vector3 elementMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 elementMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (const Cluster& cluster : m_clusters) {
+			elementMin = Vector3Min(elementMin, cluster.boundingBox.min);
+			elementMax = Vector3Max(elementMax, cluster.boundingBox.max);
+		}
+
+		m_boundingBox = { elementMin, elementMax };
+	}
+
+	void TerrainElement::markBoundsDirty() {
+		m_boundsDirty = true;
+	}
+
+	void TerrainElement::markBoundsDirty(int minX, int minZ, int maxX, int maxZ) {
+		if (m_regionDirty) {
+			minX = std::min(minX, m_dirtyMinX);
+			minZ = std::min(minZ, m_dirtyMinZ);
+			maxX = std::max(maxX, m_dirtyMaxX);
+			maxZ = std::max(maxZ, m_dirtyMaxZ);
+		}
+
+		m_regionDirty = true;
+		m_dirtyMinX = minX;
+		m_dirtyMinZ = minZ;
+		m_dirtyMaxX = maxX;
+		m_dirtyMaxZ = maxZ;
 	}
 
 	template <typename T>
@@ -75,50 +177,22 @@ namespace Terrain {
 	}
 
 	void TerrainElement::initialiseFlatMesh() {
+		markBoundsDirty();
 		flatTerrainVertices();
 		flatTerrainNormals();
-		flatTerrainIndices();
-		flatTerrainTexcoords();
-	}
-
-	int TerrainElement::getIdFromPosId(PositionIdentifier posId) {
-		// Since x and z in posId are only in top right quadrant this calculates actual x and z index
-		int absXIndex = (posId.x * posId.i) + (std::min(0, posId.i));
-		int absZIndex = (posId.z * posId.n) + (std::min(0, posId.n));
-
-		// Cantor pairing function with ability to handle negative numbers
-		if (absXIndex < 0) absXIndex = (-2 * absXIndex) - 1;
-		else absXIndex *= 2;
-
-		if (absZIndex < 0) absZIndex = (-2 * absZIndex) - 1;
-		else absZIndex *= 2;
-
-		return (((absXIndex + absZIndex) * (absXIndex + absZIndex + 1)) / 2) + absZIndex;
 	}
 
 	TerrainElement::~TerrainElement() {
 		Unload();
 	}
 
-	TerrainElement::TerrainElement(std::shared_ptr<terrain_settings> settings, PositionIdentifier posId) : settings(settings), posId(posId), meshUploaded(false) {
-		id = getIdFromPosId(posId);
-		m_position = getPositionFromPosId();
+	TerrainElement::TerrainElement(std::shared_ptr<terrain_settings> settings, ElementKey key) : settings(settings), key(key), meshUploaded(false) {
+		id = nextId++;
+		m_position = getPositionFromKey();
 
 		TraceLog(LOG_DEBUG, "TerrainElement: New element %i has been created", id);
 	}
 
-	TerrainElement::TerrainElement(PositionIdentifier posId) : posId(posId), id(getIdFromPosId(posId)) {
-		TraceLog(LOG_DEBUG, "TerrainElement: New search element %i has been created", id);
-	}
-
-	TerrainElement::TerrainElement(const TerrainElement& other) : MeshObject(other), id(other.id), settings(other.settings), posId(other.posId), dynamicMesh(other.dynamicMesh), meshUploaded(other.meshUploaded), modelUploaded(other.modelUploaded) {
-		noiseLayerPixels = std::vector<Color*>(other.noiseLayerPixels.size(), nullptr);
-		for (int i = 0; i < other.noiseLayerPixels.size(); i++) {
-			noiseLayerPixels[i] = (Color*)RL_MALLOC(sizeof(Color) * settings->numWidth * settings->numHeight);
-			memcpy(noiseLayerPixels[i], other.noiseLayerPixels[i], sizeof(Color) * settings->numWidth * settings->numHeight);
-		}
-	}
-
 	void TerrainElement::initialiseMesh() {
 		TraceLog(LOG_DEBUG, "TerrainElement: Initialising mesh of element %i", id);
 
@@ -126,10 +200,15 @@ namespace Terrain {
 		meshUploaded = false;
 		m_mesh.vertices = (float*)RL_MALLOC(settings->numWidth * settings->numHeight * 3 * sizeof(float));
 		m_mesh.vertexCount = settings->numWidth * settings->numHeight;
-		m_mesh.indices = (unsigned short*)RL_MALLOC((settings->numWidth - 1) * (settings->numHeight - 1) * 6 * sizeof(unsigned short));
 		m_mesh.triangleCount = (settings->numWidth - 1) * (settings->numHeight - 1) * 2;
 		m_mesh.normals = (float*)RL_MALLOC(settings->numWidth * settings->numHeight * 3 * sizeof(float));
 		m_mesh.texcoords = (float*)RL_MALLOC(settings->numWidth * settings->numHeight * 2 * sizeof(float));
+		m_kernels = &GridKernels::getKernels(settings->numWidth, settings->numHeight);
+		initialiseClusters();
+
+		// Indices and texcoords only depend on the grid, so they are ready before the first upload even if the heights are still being generated
+		flatTerrainIndices();
+		flatTerrainTexcoords();
 	}
 
 	void TerrainElement::initialiseElementWithFlatTerrain() {
@@ -148,24 +227,45 @@ namespace Terrain {
 		updateNoiseLayers();
 		randomizeTerrain();
 		updateNormals();
-		updateBoundingBox();
+		updateClusterBounds();
+		m_meshVersion++;
 		m_reload.store(true);
 	}
 
 	void TerrainElement::Upload() {
 		TraceLog(LOG_DEBUG, "TerrainElement: Uploading element %i", id);
 
-		UploadMesh(&m_mesh, dynamicMesh);
+		// Freed after the last upload, so an element that has been released from the GPU builds them again
+		if (!m_mesh.texcoords) {
+			m_mesh.texcoords = (float*)RL_MALLOC(m_mesh.vertexCount * 2 * sizeof(float));
+			flatTerrainTexcoords();
+		}
+		if (!uploadIntoArena()) UploadMesh(&m_mesh, dynamicMesh);
 		meshUploaded = true;
+
+		// Texcoords never change after the upload, so the GPU copy is the only one needed
+		RL_FREE(m_mesh.texcoords);
+		m_mesh.texcoords = nullptr;
 	}
 
 	void TerrainElement::Unload() {
 		TraceLog(LOG_DEBUG, "TerrainElement: Unloaded element %i", id);
 
-		if (meshUploaded && *modelUploaded) UnloadMesh(m_mesh); // BETTER WAY TO DECIDE WHEN TO UNLOAD. BEST WOULD BE IF UNLOAD MODEL IS CALLED MESH UPLOADED IS SET TO FALSE FOR EVERYONE
+		releaseArenaSlot();
+		if (meshUploaded && *modelUploaded) unloadMesh(); // BETTER WAY TO DECIDE WHEN TO UNLOAD. BEST WOULD BE IF UNLOAD MODEL IS CALLED MESH UPLOADED IS SET TO FALSE FOR EVERYONE
+		if (m_simplifiedUploaded && *modelUploaded) UnloadMesh(m_simplifiedMesh);
+		if (m_pendingSimplifiedMesh.vertices) UnloadMesh(m_pendingSimplifiedMesh);
+		if (m_normalMap.id != 0 && *modelUploaded) UnloadTexture(m_normalMap);
 		UnloadLayers();
 
 		meshUploaded = false;
+		m_simplifiedUploaded = false;
+		m_simplifiedMesh = { 0 };
+		m_pendingSimplifiedMesh = { 0 };
+		m_normalMap = { 0 };
+		m_hasNormalMap = false;
+		std::vector<float>().swap(m_normalLines);
+		m_normalLinesVersion = 0;
 	}
 
 	void TerrainElement::UnloadLayers() {
@@ -184,20 +284,34 @@ namespace Terrain {
 	void TerrainElement::randomizeTerrain() {
 		TraceLog(LOG_DEBUG, "TerrainElement: Randomizing terrain of element %i", id);
 
-		int numVertices = m_mesh.vertexCount * 3;
-		for (int i = 0; i < numVertices; i += 3) {
-			int indexX = (i / 3 / settings->numHeight);
-			int indexZ = (i / 3 % settings->numHeight);
-			m_mesh.vertices[i + 1] = Noise::noiseHeight(noiseLayerPixels, noiseSettings->noiseLayerSettings, indexX, indexZ, settings->numWidth);
-		}
+		// The noise layers are only needed to compose the base heights, so they are generated on demand and freed right after
+		if (noiseLayerPixels.empty()) updateNoiseLayers();
+		m_baseHeights.resize(m_mesh.vertexCount);
+		m_kernels->composeHeights(m_baseHeights.data(), noiseLayerPixels, noiseSettings->noiseLayerSettings, settings->numWidth, settings->numHeight);
+		UnloadLayers();
+
+		restoreBaseHeights();
+	}
+
+	void TerrainElement::restoreBaseHeights() {
+		markBoundsDirty();
+		flatTerrainVertices();
+		if (m_baseHeights.size() == static_cast<size_t>(m_mesh.vertexCount)) m_kernels->applyHeights(m_mesh.vertices, m_baseHeights.data(), settings->numWidth, settings->numHeight);
 	}
 
 	void TerrainElement::updatePosition() {
-		m_position = getPositionFromPosId();
+		m_position = getPositionFromKey();
 	}
 
 	void TerrainElement::updateNormals() {
-		// TODO: IMPLEMENT
+		updateNormals(0, 0, settings->numWidth - 1, settings->numHeight - 1);
+	}
+
+	void TerrainElement::updateNormals(int minX, int minZ, int maxX, int maxZ) {
+		if (!m_mesh.vertices || !m_mesh.normals) return;
+
+		// The normals at the border of an element only see the vertices of this element
+		m_kernels->computeNormals(m_mesh.vertices, m_mesh.normals, settings->numWidth, settings->numHeight, minX, minZ, maxX, maxZ);
 	}
 
 	void TerrainElement::reloadMeshData() {
@@ -205,21 +319,27 @@ namespace Terrain {
 
 		bool meshUploaded = this->meshUploaded && modelUploaded;
 
+		m_meshVersion++;
+		if (m_simplifiedUploaded) m_drawMeshChanged.store(true); // The simplified mesh is outdated now, so the full mesh is drawn until it is rebuilt
+		updateDirtyBounds();
 		if (!meshUploaded) return;
 
+		if (m_arenaSlot != -1) {
+			m_arena->update(m_arenaSlot, m_mesh.vertices, m_mesh.normals);
+			return;
+		}
+
+		// Indices and texcoords never change, so only positions and normals are updated
 		UpdateMeshBuffer(m_mesh, 0, m_mesh.vertices, m_mesh.vertexCount * 3 * sizeof(float), 0);
-		UpdateMeshBuffer(m_mesh, 6, m_mesh.indices, m_mesh.triangleCount * 3 * sizeof(unsigned short), 0);
 		UpdateMeshBuffer(m_mesh, 2, m_mesh.normals, m_mesh.vertexCount * 3 * sizeof(float), 0);
-		UpdateMeshBuffer(m_mesh, 1, m_mesh.texcoords, m_mesh.vertexCount * 2 * sizeof(float), 0);
-
-		updateBoundingBox();
 	}
 
 	void TerrainElement::renewMeshData() {
 		TraceLog(LOG_DEBUG, "Terrain Element: Renewing mesh data of element %i", id);
 
 		if (meshUploaded && modelUploaded) {
-			UnloadMesh(m_mesh);
+			releaseArenaSlot();
+			unloadMesh();
 			meshUploaded = false;
 		}
 
@@ -236,20 +356,199 @@ namespace Terrain {
 			Upload();
 			m_upload.store(false);
 		}
+		if (m_simplified.load()) {
+			installSimplifiedMesh();
+			m_simplified.store(false);
+		}
+	}
+
+	void TerrainElement::beginSimplification(float maxError) {
+		// Snapshot the mesh on the calling thread, so the worker never reads vertices that are being manipulated
+		m_simplifying.store(true);
+		m_pendingVersion = m_meshVersion.load();
+		m_pendingError = maxError;
+		m_pendingBakeNormalMap = settings->useNormalMaps;
+		m_simplificationVertices.assign(m_mesh.vertices, m_mesh.vertices + m_mesh.vertexCount * 3);
+		if (m_mesh.normals) m_simplificationNormals.assign(m_mesh.normals, m_mesh.normals + m_mesh.vertexCount * 3);
+	}
+
+	void TerrainElement::simplifyMesh() {
+		TraceLog(LOG_DEBUG, "TerrainElement: Simplifying mesh of element %i", id);
+
+		const float* normals = m_simplificationNormals.empty() ? nullptr : m_simplificationNormals.data();
+		m_pendingSimplifiedMesh = MeshSimplifier::simplifyGrid(m_simplificationVertices.data(), normals, settings->numWidth, settings->numHeight, m_pendingError);
+		if (m_pendingBakeNormalMap) bakeNormalMap();
+
+		std::vector<float>().swap(m_simplificationVertices);
+		std::vector<float>().swap(m_simplificationNormals);
+	}
+
+	bool TerrainElement::needsSimplification(float maxError) const {
+		if (m_simplifying.load() || !meshUploaded || m_meshVersion.load() == 0) return false;
+
+		return !m_simplifiedUploaded || m_simplifiedVersion != m_meshVersion.load() || m_simplificationError != maxError || (settings->useNormalMaps && !m_hasNormalMap);
+	}
+
+	bool TerrainElement::isSimplifying() const {
+		return m_simplifying.load() && !m_simplified.load();
+	}
+
+	void TerrainElement::installSimplifiedMesh() {
+		m_simplifying.store(false);
+
+		// The vertices changed while the worker was simplifying, so the result is already outdated
+		if (m_pendingVersion != m_meshVersion.load()) {
+			UnloadMesh(m_pendingSimplifiedMesh);
+			m_pendingSimplifiedMesh = { 0 };
+			std::vector<Color>().swap(m_pendingNormalMap);
+			return;
+		}
+
+		dropSimplifiedMesh();
+		m_simplifiedMesh = m_pendingSimplifiedMesh;
+		m_pendingSimplifiedMesh = { 0 };
+		UploadMesh(&m_simplifiedMesh, false);
+		m_simplifiedUploaded = true;
+		m_simplifiedVersion = m_pendingVersion;
+		m_simplificationError = m_pendingError;
+		if (!m_pendingNormalMap.empty()) uploadNormalMap();
+		m_drawMeshChanged.store(true);
+	}
+
+	void TerrainElement::bakeNormalMap() {
+		// Runs on the worker next to the simplification, so it only reads the snapshot taken by beginSimplification()
+		size_t numVertices = static_cast<size_t>(settings->numWidth) * settings->numHeight;
+		if (m_simplificationNormals.size() != numVertices * 3) {
+			m_simplificationNormals.resize(numVertices * 3);
+			m_kernels->computeNormals(m_simplificationVertices.data(), m_simplificationNormals.data(), settings->numWidth, settings->numHeight, 0, 0, settings->numWidth - 1, settings->numHeight - 1);
+		}
+
+		// The texture is stored row by row along x, while the vertices are stored column by column along z
+		m_pendingNormalMap.resize(numVertices);
+		for (int x = 0; x < settings->numWidth; x++) {
+			for (int z = 0; z < settings->numHeight; z++) {
+				const float* normal = &m_simplificationNormals[(x * settings->numHeight + z) * 3];
+				m_pendingNormalMap[z * settings->numWidth + x] = {
+					static_cast<unsigned char>((normal[0] * 0.5f + 0.5f) * 255.0f),
+					static_cast<unsigned char>((normal[1] * 0.5f + 0.5f) * 255.0f),
+					static_cast<unsigned char>((normal[2] * 0.5f + 0.5f) * 255.0f),
+					255
+				};
+			}
+		}
+	}
+
+	void TerrainElement::uploadNormalMap() {
+		if (m_normalMap.id != 0 && (m_normalMap.width != settings->numWidth || m_normalMap.height != settings->numHeight)) {
+			UnloadTexture(m_normalMap);
+			m_normalMap = { 0 };
+		}
+
+		if (m_normalMap.id == 0) {
+			Image image = { m_pendingNormalMap.data(), settings->numWidth, settings->numHeight, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+			m_normalMap = LoadTextureFromImage(image);
+			SetTextureFilter(m_normalMap, TEXTURE_FILTER_BILINEAR);
+			SetTextureWrap(m_normalMap, TEXTURE_WRAP_CLAMP);
+		}
+		else UpdateTexture(m_normalMap, m_pendingNormalMap.data());
+
+		std::vector<Color>().swap(m_pendingNormalMap);
+		m_hasNormalMap = true;
+	}
+
+	bool TerrainElement::uploadIntoArena() {
+		if (!settings->useBufferArena) return false;
+
+		// Every element of the same size shares texcoords and indices, so the first one to be uploaded sets up the arena
+		int indexCount = m_mesh.triangleCount * 3;
+		if (!settings->bufferArena || !settings->bufferArena->fits(m_mesh.vertexCount, m_mesh.indices, indexCount)) {
+			settings->bufferArena = std::make_shared<MeshArena>(m_mesh.vertexCount, m_mesh.texcoords, m_mesh.indices, indexCount);
+		}
+
+		releaseArenaSlot();
+		m_arena = settings->bufferArena;
+		m_arenaSlot = m_arena->allocate();
+		m_arena->update(m_arenaSlot, m_mesh.vertices, m_mesh.normals);
+		return true;
+	}
+
+	void TerrainElement::unloadMesh() {
+		// The indices are shared with other elements, so they must not be freed by UnloadMesh()
+		m_mesh.indices = nullptr;
+		m_sharedIndices.reset();
+		UnloadMesh(m_mesh);
+	}
+
+	void TerrainElement::releaseArenaSlot() {
+		if (m_arenaSlot == -1) return;
+
+		m_arena->release(m_arenaSlot);
+		m_arena.reset();
+		m_arenaSlot = -1;
+	}
+
+	void TerrainElement::dropSimplifiedMesh() {
+		if (!m_simplifiedUploaded) return;
+
+		UnloadMesh(m_simplifiedMesh);
+		m_simplifiedMesh = { 0 };
+		m_simplifiedUploaded = false;
+		m_hasNormalMap = false;
+		m_drawMeshChanged.store(true);
+	}
+
+	void TerrainElement::releaseGpuData() {
+		if (!meshUploaded) return;
+
+		TraceLog(LOG_DEBUG, "TerrainElement: Released GPU data of element %i", id);
+
+		// Only the buffers are freed, the vertices stay the source of truth for the next upload
+		if (m_arenaSlot != -1) releaseArenaSlot();
+		else MeshRenderer::unloadMeshBuffers(m_mesh);
+		dropSimplifiedMesh();
+		if (m_normalMap.id != 0) UnloadTexture(m_normalMap);
+
+		meshUploaded = false;
+		m_normalMap = { 0 };
+		m_hasNormalMap = false;
+		std::vector<float>().swap(m_normalLines);
+		m_normalLinesVersion = 0;
+		m_drawMeshChanged.store(true);
 	}
 
 	unsigned int TerrainElement::getId() const {
 		return id;
 	}
 
-	PositionIdentifier TerrainElement::getPosId() const {
-		return posId;
+	ElementKey TerrainElement::getKey() const {
+		return key;
 	}
 
 	Mesh& TerrainElement::refMesh() {
 		return m_mesh;
 	}
 
+	Mesh& TerrainElement::refDrawMesh() {
+		if (m_simplifiedUploaded && m_simplifiedVersion == m_meshVersion.load()) return m_simplifiedMesh;
+		return m_mesh;
+	}
+
+	bool TerrainElement::isDrawable() const {
+		return meshUploaded && m_meshVersion.load() > 0;
+	}
+
+	bool TerrainElement::isReady() const {
+		return m_meshVersion.load() > 0 && !m_reload.load() && !m_upload.load();
+	}
+
+	const std::vector<TerrainElement::Cluster>& TerrainElement::getClusters() const {
+		return m_clusters;
+	}
+
+	bool TerrainElement::consumeDrawMeshChanged() {
+		return m_drawMeshChanged.exchange(false);
+	}
+
 	void TerrainElement::setModelUploaded(std::shared_ptr<bool> modelUploaded) {
 		this->modelUploaded = modelUploaded;
 	}
@@ -261,4 +560,71 @@ namespace Terrain {
 	std::atomic<bool>* TerrainElement::getUploadFlag() {
 		return &m_upload;
 	}
+
+	std::atomic<bool>* TerrainElement::getSimplifiedFlag() {
+		return &m_simplified;
+	}
+
+	MeshArena* TerrainElement::getArena() const {
+		return m_arena.get();
+	}
+
+	std::shared_ptr<MeshArena> TerrainElement::getSharedArena() const {
+		return m_arena;
+	}
+
+	int TerrainElement::getArenaSlot() const {
+		return m_arenaSlot;
+	}
+
+	bool TerrainElement::isGpuResident() const {
+		return meshUploaded;
+	}
+
+	size_t TerrainElement::getGpuBytes() const {
+		// Positions, normals and texcoords of the full mesh, the indices are shared with every other element of the same size
+		size_t bytes = static_cast<size_t>(m_mesh.vertexCount) * 8 * sizeof(float);
+		if (m_simplifiedUploaded) bytes += static_cast<size_t>(m_simplifiedMesh.vertexCount) * 8 * sizeof(float) + m_simplifiedMesh.triangleCount * 3 * sizeof(unsigned short);
+		if (m_normalMap.id != 0) bytes += static_cast<size_t>(m_normalMap.width) * m_normalMap.height * 4;
+		return bytes;
+	}
+
+	size_t TerrainElement::getCpuBytes() const {
+		size_t bytes = static_cast<size_t>(m_mesh.vertexCount) * 6 * sizeof(float) + m_baseHeights.size() * sizeof(float);
+		if (m_mesh.texcoords) bytes += static_cast<size_t>(m_mesh.vertexCount) * 2 * sizeof(float);
+		return bytes;
+	}
+
+	size_t TerrainElement::getPendingUploadBytes() const {
+		size_t bytes = 0;
+		// A reload only updates positions and normals, an upload sends the texcoords along
+		if (m_upload.load()) bytes += static_cast<size_t>(m_mesh.vertexCount) * 8 * sizeof(float);
+		if (m_reload.load()) bytes += static_cast<size_t>(m_mesh.vertexCount) * 6 * sizeof(float);
+		if (m_simplified.load()) {
+			bytes += static_cast<size_t>(m_pendingSimplifiedMesh.vertexCount) * 8 * sizeof(float) + m_pendingSimplifiedMesh.triangleCount * 3 * sizeof(unsigned short);
+			bytes += m_pendingNormalMap.size() * sizeof(Color);
+		}
+		return bytes;
+	}
+
+	int TerrainElement::getModelSlot() const {
+		return m_modelSlot;
+	}
+
+	void TerrainElement::setModelSlot(int modelSlot) {
+		m_modelSlot = modelSlot;
+	}
+
+	Texture2D TerrainElement::getNormalMap() {
+		if (!m_hasNormalMap || &refDrawMesh() != &m_simplifiedMesh) return { 0 };
+		return m_normalMap;
+	}
+
+	const std::vector<float>& TerrainElement::refNormalLines() {
+		if (m_normalLinesVersion != m_meshVersion.load() && m_mesh.vertices && m_mesh.normals) {
+			MeshRenderer::updateNormalLines(m_normalLines, m_mesh.vertices, m_mesh.normals, m_mesh.vertexCount, 1.0f);
+			m_normalLinesVersion = m_meshVersion.load();
+		}
+		return m_normalLines;
+	}
 }
\ No newline at end of file
@@ -1,7 +1,28 @@
 #include "Terrain/TerrainManager.h"
 
 namespace Terrain {
+	namespace {
+		// Only overwrites value if the field exists, so settings files written before the field was added still load
+		template <typename T>
+		void loadOptionalField(const FileAdapter& file, std::string key, T& value) {
+			FileAdapter::FileField field = file.getField(key);
+			if (field.getKey() != "") value = std::any_cast<T>(field.getValue());
+		}
+
+		// Calls func for every cell of first..last that is not part of otherFirst..otherLast, a range with first > last is empty
+		template <typename Func>
+		void forEachCellOutside(int first, int last, int otherFirst, int otherLast, Func func) {
+			if (otherFirst > otherLast) {
+				for (int cell = first; cell <= last; cell++) func(cell);
+				return;
+			}
+			for (int cell = first; cell <= std::min(last, otherFirst - 1); cell++) func(cell);
+			for (int cell = std::max(first, otherLast + 1); cell <= last; cell++) func(cell);
+		}
+	} // private namespace
+
 	TerrainManager::TerrainManager(std::string name, terrain_settings terrainSettings) : Actor<Vector3>(name), settings(std::make_shared<terrain_settings>(terrainSettings)) {
+		m_diffLayout = getDiffLayout();
 		TraceLog(LOG_DEBUG, "TerrainManager: New TerrainManager created");
 	}
 
@@ -24,23 +45,20 @@ namespace Terrain {
 	}
 
 	void TerrainManager::removeDifference() {
-		for (std::unordered_set<ManipulableTerrainElement>::iterator it = elements.begin(); it != elements.end(); it++) {
-			ManipulableTerrainElement& element = const_cast<ManipulableTerrainElement&>(*it); // Const can be cast away since the hash relevant data is not changed
-			element.removeDifference();
+		for (ManipulableTerrainElement* element : getSnapshot()->elements) {
+			element->removeDifference();
 		}
 	}
 
 	void TerrainManager::addDifference() {
-		for (std::unordered_set<ManipulableTerrainElement>::iterator it = elements.begin(); it != elements.end(); it++) {
-			ManipulableTerrainElement& element = const_cast<ManipulableTerrainElement&>(*it); // Const can be cast away since the hash relevant data is not changed
-			element.addDifference();
+		for (ManipulableTerrainElement* element : getSnapshot()->elements) {
+			element->addDifference();
 		}
 	}
 
 	void TerrainManager::clearDifference() {
-		for (std::unordered_set<ManipulableTerrainElement>::iterator it = elements.begin(); it != elements.end(); it++) {
-			ManipulableTerrainElement& element = const_cast<ManipulableTerrainElement&>(*it); // Const can be cast away since the hash relevant data is not changed
-			element.clearDifference();
+		for (ManipulableTerrainElement* element : getSnapshot()->elements) {
+			element->clearDifference();
 		}
 	}
 
@@ -53,6 +71,83 @@ namespace Terrain {
 		updateElementPositions();
 	}
 
+	bool TerrainManager::getFrustumCulling() const {
+		return m_frustumCulling;
+	}
+
+	void TerrainManager::setFrustumCulling(bool frustumCulling) {
+		m_frustumCulling = frustumCulling;
+	}
+
+	bool TerrainManager::getSortFrontToBack() const {
+		return m_sortFrontToBack;
+	}
+
+	void TerrainManager::setSortFrontToBack(bool sortFrontToBack) {
+		m_sortFrontToBack = sortFrontToBack;
+		m_renderQueueDirty.store(true);
+	}
+
+	bool TerrainManager::getOcclusionCulling() const {
+		return m_occlusionCulling;
+	}
+
+	void TerrainManager::setOcclusionCulling(bool occlusionCulling) {
+		m_occlusionCulling = occlusionCulling;
+	}
+
+	float TerrainManager::getNormalsDistance() const {
+		return m_normalsDistance;
+	}
+
+	void TerrainManager::setNormalsDistance(float normalsDistance) {
+		m_normalsDistance = normalsDistance;
+	}
+
+	int TerrainManager::getNumArenaPages() const {
+		int numPages = 0;
+		for (const std::shared_ptr<MeshArena>& arena : m_bufferArenas) {
+			numPages += arena->getNumPages();
+		}
+		return numPages;
+	}
+
+	int TerrainManager::getNumArenaSlots() const {
+		int numSlots = 0;
+		for (const std::shared_ptr<MeshArena>& arena : m_bufferArenas) {
+			numSlots += arena->getNumUsedSlots();
+		}
+		return numSlots;
+	}
+
+	int TerrainManager::getNumPendingGenerations() const {
+		return m_generationScheduler.getNumPending();
+	}
+
+	int TerrainManager::getNumRunningGenerations() const {
+		return m_generationScheduler.getNumRunning();
+	}
+
+	int TerrainManager::getNumVisibleElements() const {
+		return m_numVisibleElements;
+	}
+
+	int TerrainManager::getNumCulledElements() const {
+		return m_numCulledElements;
+	}
+
+	int TerrainManager::getNumOccludedElements() const {
+		return m_numOccludedElements;
+	}
+
+	int TerrainManager::getNumVisibleClusters() const {
+		return m_numVisibleClusters;
+	}
+
+	int TerrainManager::getNumCulledClusters() const {
+		return m_numCulledClusters;
+	}
+
 	void TerrainManager::save() const {
 		save(m_filename);
 	}
@@ -82,6 +177,17 @@ namespace Terrain {
 		this->settings->updateWithThreadPool = std::any_cast<bool>(terrainSettingsFile.getField("update_with_thread_pool").getValue());
 		this->settings->followCamera = std::any_cast<bool>(terrainSettingsFile.getField("follow_camera").getValue());
 		this->settings->distToRelocating = std::any_cast<float>(terrainSettingsFile.getField("dist_to_relocating").getValue());
+		loadOptionalField(terrainSettingsFile, "simplify_meshes", this->settings->simplifyMeshes);
+		loadOptionalField(terrainSettingsFile, "simplification_error", this->settings->simplificationError);
+		loadOptionalField(terrainSettingsFile, "cluster_size", this->settings->clusterSize);
+		loadOptionalField(terrainSettingsFile, "use_buffer_arena", this->settings->useBufferArena);
+		loadOptionalField(terrainSettingsFile, "use_normal_maps", this->settings->useNormalMaps);
+		loadOptionalField(terrainSettingsFile, "prefetch_time", this->settings->prefetchTime);
+		loadOptionalField(terrainSettingsFile, "gpu_budget", this->settings->gpuBudget);
+		loadOptionalField(terrainSettingsFile, "cpu_budget", this->settings->cpuBudget);
+		loadOptionalField(terrainSettingsFile, "diff_budget", this->settings->diffBudget);
+		loadOptionalField(terrainSettingsFile, "pin_distance", this->settings->pinDistance);
+		m_diffLayout = getDiffLayout();
 		loadNoiseSettings(file.getSubElement("noise_settings"));
 		loadTerrainElements(file.getSubElement("terrain_elements"));
 		Actor::load(file);
@@ -98,6 +204,16 @@ namespace Terrain {
 		settings.addField(FileAdapter::FileField("update_with_thread_pool", FileAdapter::ValueType::BOOL, this->settings->updateWithThreadPool));
 		settings.addField(FileAdapter::FileField("follow_camera", FileAdapter::ValueType::BOOL, this->settings->followCamera));
 		settings.addField(FileAdapter::FileField("dist_to_relocating", FileAdapter::ValueType::FLOAT, this->settings->distToRelocating));
+		settings.addField(FileAdapter::FileField("simplify_meshes", FileAdapter::ValueType::BOOL, this->settings->simplifyMeshes));
+		settings.addField(FileAdapter::FileField("use_buffer_arena", FileAdapter::ValueType::BOOL, this->settings->useBufferArena));
+		settings.addField(FileAdapter::FileField("use_normal_maps", FileAdapter::ValueType::BOOL, this->settings->useNormalMaps));
+		settings.addField(FileAdapter::FileField("prefetch_time", FileAdapter::ValueType::FLOAT, this->settings->prefetchTime));
+		settings.addField(FileAdapter::FileField("gpu_budget", FileAdapter::ValueType::FLOAT, this->settings->gpuBudget));
+		settings.addField(FileAdapter::FileField("cpu_budget", FileAdapter::ValueType::FLOAT, this->settings->cpuBudget));
+		settings.addField(FileAdapter::FileField("diff_budget", FileAdapter::ValueType::FLOAT, this->settings->diffBudget));
+		settings.addField(FileAdapter::FileField("pin_distance", FileAdapter::ValueType::FLOAT, this->settings->pinDistance));
+		settings.addField(FileAdapter::FileField("simplification_error", FileAdapter::ValueType::FLOAT, this->settings->simplificationError));
+		settings.addField(FileAdapter::FileField("cluster_size", FileAdapter::ValueType::INT, this->settings->clusterSize));
 	}
 
 	void TerrainManager::saveNoiseSettings(FileAdapter& json) const {
@@ -123,53 +239,111 @@ namespace Terrain {
 	void TerrainManager::saveTerrainElements(FileAdapter& file) const {
 		FileAdapter& elementsFile = file.getSubElement("terrain_elements");
 		elementsFile.clear();
-		for (auto& [posId, value] : m_loadedManipulations) {
-			if (std::isnan(value[0])) continue; // No difference and markes with NaN because Element doesnt exist anymore
+		auto saveDifference = [this, &elementsFile](ElementKey elementKey, const float* heightArray) {
 			bool diffFound = false;
 			for (int i = 0; i < settings->numWidth * settings->numHeight * 3; i++) {
-				if (value[i] != 0.0f) {
+				if (heightArray[i] != 0.0f) {
 					diffFound = true;
 					break;
 				}
 			}
-			if (!diffFound) continue;
+			if (!diffFound) return;
 
 			// Now the value contains valid difference so save it
-			std::string key = "x" + std::to_string(posId.x) + "i" + std::to_string(posId.i) + "z" + std::to_string(posId.z) + "n" + std::to_string(posId.n);
+			std::string key = "x" + std::to_string(elementKey.getCellX()) + "z" + std::to_string(elementKey.getCellZ());
 			FileAdapter& curElement = elementsFile.getSubElement(key);
 			curElement.clear();
-			const float* heightArray = value.get();
 			std::vector<std::any> heightDifference(heightArray, heightArray + (settings->numWidth * settings->numHeight * 3));
 			curElement.addArray(FileAdapter::FileArray("heightDifference", FileAdapter::ValueType::FLOAT, heightDifference));
+			};
+		// Diffs still being resampled are finished here, saving is rare enough to wait for them and the relocation
+		std::lock_guard<std::mutex> lock(m_updating);
+		for (auto& [elementKey, resample] : m_diffResamples) {
+			runDiffResample(*resample);
+		}
+		for (auto& [elementKey, value] : m_loadedManipulations) {
+			if (std::isnan(value[0])) continue; // No difference and markes with NaN because Element doesnt exist anymore
+			saveDifference(elementKey, value.get());
+		}
+		// Diffs moved into a cheaper tier are decoded one at a time, so they never all have to be in memory again
+		m_residency.forEachStoredDiff([this, &saveDifference](ElementKey elementKey, const std::vector<float>& diff) {
+			if (diff.size() == static_cast<size_t>(settings->numWidth * settings->numHeight * 3)) saveDifference(elementKey, diff.data());
+			});
+	}
+
+	void TerrainManager::initialiseAndAddNewElement(ElementKey key) {
+		if (elements.find(key)) return;
+
+		// Elements of interest regions are already part of the model and the snapshot, only their owner changes
+		SharedElementMap::iterator shared = m_sharedElements.find(key);
+		if (shared != m_sharedElements.end() && shared->second.element) {
+			elements.insert(std::move(shared->second.element));
+			return;
+		}
+
+		// Elements generated ahead of the camera only have to be moved into the grid
+		WarmElementMap::iterator warm = m_warmElements.find(key);
+		if (warm != m_warmElements.end()) {
+			m_generationScheduler.promote(key);
+			m_modelChanges.push_back({ &elements.insert(std::move(warm->second)), true });
+			m_warmElements.erase(warm);
+			m_numWarmElements.store(static_cast<int>(m_warmElements.size()));
+			return;
 		}
+
+		m_modelChanges.push_back({ &elements.insert(createElement(key, false)), true });
 	}
 
-	void TerrainManager::initialiseAndAddNewElement(std::unordered_set<ManipulableTerrainElement>& newElements, const PositionIdentifier& posId) {
-		// Directly emplace a new ManipulableTerrain into the container
+	std::unique_ptr<ManipulableTerrainElement> TerrainManager::createElement(ElementKey key, bool prefetch) {
+		// Elements are held by pointer and never move, so tasks can safely keep pointers to them
 		std::shared_ptr<float[]> newDiff = nullptr;
-		std::unordered_map<PositionIdentifier, std::shared_ptr<float[]>>::iterator it = m_loadedManipulations.find(posId);
-		if (it == m_loadedManipulations.end()) {
-			m_loadedManipulations[posId] = std::shared_ptr<float[]>(new float[settings->numWidth * settings->numHeight * 3], std::default_delete<float[]>());
-			newDiff = m_loadedManipulations[posId];
+		std::shared_ptr<float[]> existingDiff = nullptr;
+		std::shared_ptr<DiffResample> resample = nullptr;
+		DiffResampleMap::iterator resampleIt = m_diffResamples.find(key);
+		if (resampleIt != m_diffResamples.end()) resample = resampleIt->second;
+		m_residency.restoreDiff(key, m_loadedManipulations);
+		ManipulationMap::iterator it = m_loadedManipulations.find(key);
+		if (resample) existingDiff = resample->target; // Possibly still written by a worker, so it is only read by the job after resampling it
+		else if (it == m_loadedManipulations.end()) {
+			m_loadedManipulations[key] = std::shared_ptr<float[]>(new float[settings->numWidth * settings->numHeight * 3], std::default_delete<float[]>());
+			newDiff = m_loadedManipulations[key];
 		}
 		else if (std::isnan(*(it->second.get()))) {
 			*(it->second.get()) = 0.0f;
 			newDiff = it->second;
 		}
-		auto result = newElements.emplace(settings, posId, newDiff);
-		if (result.second) { // Check if insertion was successful
-			ManipulableTerrainElement* newElement = const_cast<ManipulableTerrainElement*>(&*result.first);
-			newElement->setModelUploaded(modelUploaded);
-			newElement->initialiseMesh();
-			auto initialise = [this, newElement, posId, newDiff]() {
-				newElement->initialiseElementWithNoiseTerrain(this->noiseSettings);
-				if (!newDiff) newElement->loadDifference(this->m_loadedManipulations[posId]);
-				};
-			if (settings->updateWithThreadPool && settings->threadPool) settings->threadPool->addTask(initialise, nullptr);
-			else initialise();
-			newElement->getUploadFlag()->store(true);
+		else existingDiff = it->second; // Held by the job, so the diff can not be moved into another tier before it is loaded
+
+		std::unique_ptr<ManipulableTerrainElement> element = std::make_unique<ManipulableTerrainElement>(settings, key, newDiff);
+		ManipulableTerrainElement* newElement = element.get();
+		newElement->setModelUploaded(modelUploaded);
+		newElement->initialiseMesh();
+		auto initialise = [this, newElement, newDiff, existingDiff, resample]() {
+			newElement->initialiseElementWithNoiseTerrain(this->noiseSettings);
+			if (resample) runDiffResample(*resample);
+			if (!newDiff) newElement->loadDifference(existingDiff);
+			};
+		if (settings->updateWithThreadPool && settings->threadPool) {
+			// Queued by distance to the camera, the closest elements are handed to the pool first
+			Vector3 elementCenter = Vector3Add(newElement->getPosition(), { (settings->numWidth - 1) * settings->spacing / 2.0f, 0.0f, (settings->numHeight - 1) * settings->spacing / 2.0f });
+			m_generationScheduler.schedule(key, Vector3Add(Vector3Scale(elementCenter, m_scale), m_position), initialise, prefetch);
+		}
+		else initialise();
+		newElement->getUploadFlag()->store(true);
+
+		TraceLog(LOG_DEBUG, "Terrain: New element %i has been created", newElement->getId());
+		return element;
+	}
 
-			TraceLog(LOG_DEBUG, "Terrain: New element has been created", newElement->getId());
+	void TerrainManager::simplifyElement(ManipulableTerrainElement* element) {
+		element->beginSimplification(settings->simplificationError);
+		auto simplify = [element]() {
+			element->simplifyMesh();
+			};
+		if (settings->updateWithThreadPool && settings->threadPool) settings->threadPool->addTask(simplify, element->getSimplifiedFlag());
+		else {
+			simplify();
+			element->getSimplifiedFlag()->store(true);
 		}
 	}
 
@@ -177,16 +351,35 @@ namespace Terrain {
 		return std::max(0., sqrt(pow(spawnRadius, 2) - pow(x, 2)));
 	}
 
-	void TerrainManager::loadElementsIntoModel() {
-		m_model.meshCount = elements.size();
-		m_model.meshes = (Mesh*)RL_CALLOC(m_model.meshCount, sizeof(Mesh));
+	void TerrainManager::addToModel(ManipulableTerrainElement* element) {
+		if (element->getModelSlot() != -1) return;
 
-		int index = 0;
-		for (std::unordered_set<ManipulableTerrainElement>::iterator it = elements.begin(); it != elements.end(); it++) {
-			ManipulableTerrainElement& element = const_cast<ManipulableTerrainElement&>(*it); // Const can be cast away since the hash relevant data is not changed
-			m_model.meshes[index] = element.refMesh();
-			index++;
+		// Doubling the capacity, so appending stays O(1) amortised
+		if (m_model.meshCount == m_modelCapacity) {
+			m_modelCapacity = std::max(16, m_modelCapacity * 2);
+			m_model.meshes = (Mesh*)RL_REALLOC(m_model.meshes, m_modelCapacity * sizeof(Mesh));
+			m_model.meshMaterial = (int*)RL_REALLOC(m_model.meshMaterial, m_modelCapacity * sizeof(int));
 		}
+
+		int slot = m_model.meshCount++;
+		m_model.meshes[slot] = element->refDrawMesh();
+		m_model.meshMaterial[slot] = 0;
+		m_modelElements.push_back(element);
+		element->setModelSlot(slot);
+	}
+
+	void TerrainManager::removeFromModel(ManipulableTerrainElement* element) {
+		int slot = element->getModelSlot();
+		if (slot == -1) return;
+
+		// The order of the meshes does not matter, so the gap is filled with the last one
+		int last = --m_model.meshCount;
+		m_model.meshes[slot] = m_model.meshes[last];
+		m_model.meshMaterial[slot] = m_model.meshMaterial[last];
+		m_modelElements[slot] = m_modelElements[last];
+		m_modelElements[slot]->setModelSlot(slot);
+		m_modelElements.pop_back();
+		element->setModelSlot(-1);
 	}
 
 	void TerrainManager::initializeModelMaterials() {
@@ -195,17 +388,34 @@ namespace Terrain {
 		m_model.materials = (Material*)RL_CALLOC(m_model.materialCount, sizeof(Material));
 
 		m_model.materials[0] = LoadMaterialDefault();
+	}
 
-		// Giving every mesh the default material
-		m_model.meshMaterial = (int*)RL_CALLOC(m_model.meshCount, sizeof(int));
-		for (int i = 0; i < m_model.meshCount; i++) {
-			m_model.meshMaterial[i] = 0;
-		}
+	void TerrainManager::loadTerrainShader() {
+		if (m_terrainShader.hasShader()) return;
+
+		m_terrainShader.useShader(LoadShader("data/shaders/terrain.vs", "data/shaders/terrain.fs"));
+		m_useNormalMapLoc = GetShaderLocation(m_terrainShader.getShader(), "useNormalMap");
+	}
+
+	bool TerrainManager::useTerrainShader(Material& material) {
+		if (!settings->useNormalMaps || !m_terrainShader.hasShader()) return false;
+
+		material.shader = m_terrainShader.getShader();
+		setNormalMap(material, { 0 });
+		return true;
+	}
+
+	void TerrainManager::setNormalMap(Material& material, Texture2D normalMap) {
+		// Without a normal map the shader falls back to the normals of the mesh
+		material.maps[MATERIAL_MAP_NORMAL].texture = normalMap;
+		int useNormalMap = normalMap.id != 0 ? 1 : 0;
+		SetShaderValue(m_terrainShader.getShader(), m_useNormalMapLoc, &useNormalMap, SHADER_UNIFORM_INT);
 	}
 
 	void TerrainManager::updateElementsNoise() {
-		for (std::unordered_set<ManipulableTerrainElement>::iterator it = elements.begin(); it != elements.end(); it++) {
-			ManipulableTerrainElement* element = const_cast<ManipulableTerrainElement*>(&*it); // Const can be cast away since the hash relevant data is not changed
+		std::lock_guard<std::mutex> lock(m_updating);
+		std::erase_if(m_noiseTasks, [](const auto& task) { return task.second->load(); });
+		for (ManipulableTerrainElement* element : getSnapshot()->elements) {
 			auto updateNoise = [element]() {
 				element->UnloadLayers();
 				element->updateNoiseLayers();
@@ -213,7 +423,16 @@ namespace Terrain {
 				element->updateNormals();
 				element->addDifference();
 				};
-			if (settings->updateWithThreadPool && settings->threadPool) settings->threadPool->addTask(updateNoise, element->getReloadFlag());
+			if (settings->updateWithThreadPool && settings->threadPool) {
+				// The flag is set by the task itself, the pool would write the reload flag after an element could already have been freed
+				GenerationScheduler::DoneFlag done = std::make_shared<std::atomic<bool>>(false);
+				m_noiseTasks.push_back({ element, done });
+				settings->threadPool->addTask([element, updateNoise, done]() {
+					updateNoise();
+					element->getReloadFlag()->store(true);
+					done->store(true);
+					}, nullptr);
+			}
 			else {
 				updateNoise();
 				element->reloadMeshData();
@@ -222,12 +441,13 @@ namespace Terrain {
 	}
 
 	void TerrainManager::updateModel() {
-		RL_FREE(m_model.meshes);
-		RL_FREE(m_model.materials);
-		RL_FREE(m_model.meshMaterial);
-		loadElementsIntoModel();
-		initializeModelMaterials();
-		updateBoundingBox();
+		// Only the elements that joined or left the grid are touched, the material stays the one from initializeModel()
+		for (const ModelChange& change : m_modelChanges) {
+			if (change.add) addToModel(change.element);
+			else removeFromModel(change.element);
+		}
+		m_modelChanges.clear();
+		updateTerrainBounds();
 	}
 
 	void TerrainManager::generateDefaultTerrain() {
@@ -244,27 +464,54 @@ namespace Terrain {
 			for (int i = 0; i < difference.size(); i++) {
 				heightDifference[i] = std::any_cast<float>(difference[i]);
 			}
-			m_loadedManipulations[getPositionIdentifierFromKey(key)] = std::shared_ptr<float[]>(heightDifference, std::default_delete<float[]>());
+			m_loadedManipulations[getElementKeyFromString(key)] = std::shared_ptr<float[]>(heightDifference, std::default_delete<float[]>());
 		}
 
 		TraceLog(LOG_DEBUG, "Terrain: Terrain elements have been loaded");
 	}
 
-	PositionIdentifier TerrainManager::getPositionIdentifierFromKey(std::string key) {
-		PositionIdentifier posId;
-		posId.x = std::stoi(key.substr(1, key.find("i") - 1));
-		posId.i = std::stoi(key.substr(key.find("i") + 1, key.find("z") - key.find("i") - 1));
-		posId.z = std::stoi(key.substr(key.find("z") + 1, key.find("n") - key.find("z") - 1));
-		posId.n = std::stoi(key.substr(key.find("n") + 1, key.length() - key.find("n") - 1));
-		return posId;
+	ElementKey TerrainManager::getElementKeyFromString(std::string key) {
+		// Older saves store the index inside of each half of the terrain together with the side of the half ("x0i-1z2n1")
+		if (key.find("i") != std::string::npos) {
+			int x = std::stoi(key.substr(1, key.find("i") - 1));
+			int i = std::stoi(key.substr(key.find("i") + 1, key.find("z") - key.find("i") - 1));
+			int z = std::stoi(key.substr(key.find("z") + 1, key.find("n") - key.find("z") - 1));
+			int n = std::stoi(key.substr(key.find("n") + 1, key.length() - key.find("n") - 1));
+			return ElementKey(i < 0 ? -x - 1 : x, n < 0 ? -z - 1 : z);
+		}
+
+		int cellX = std::stoi(key.substr(1, key.find("z") - 1));
+		int cellZ = std::stoi(key.substr(key.find("z") + 1));
+		return ElementKey(cellX, cellZ);
+	}
+
+	TerrainManager::HashStats TerrainManager::getManipulationHashStats() const {
+		std::lock_guard<std::mutex> lock(m_hashStatsMutex);
+		return m_manipulationHashStats;
+	}
+
+	void TerrainManager::updateManipulationHashStats() {
+		HashStats stats;
+		stats.numEntries = m_loadedManipulations.size();
+		stats.numBuckets = m_loadedManipulations.bucket_count();
+		for (size_t i = 0; i < stats.numBuckets; i++) {
+			size_t bucketSize = m_loadedManipulations.bucket_size(i);
+			if (bucketSize > 0) stats.numUsedBuckets++;
+			stats.maxBucketSize = std::max(stats.maxBucketSize, bucketSize);
+		}
+
+		std::lock_guard<std::mutex> lock(m_hashStatsMutex);
+		m_manipulationHashStats = stats;
 	}
 
 	void TerrainManager::initializeModel() {
 		m_model = newModel();
+		m_modelCapacity = 0;
+		m_modelElements.clear();
 
-		loadElementsIntoModel();
 		initializeModelMaterials();
-		updateBoundingBox();
+		loadTerrainShader();
+		updateModel();
 
 		TraceLog(LOG_DEBUG, "Terrain: Model has been initialized");
 
@@ -310,151 +557,971 @@ namespace Terrain {
 
 	void TerrainManager::updateTerrain(float oldSpawnRadius) {
 		// Check for maxNumElements
-		if (elements.size() > settings->maxNumElements) {
-			std::unordered_set<ManipulableTerrainElement>::iterator start = std::next(elements.begin(), settings->maxNumElements);
-		
-			// Free memory used by the elements and delete from the set
-			for (std::unordered_set<ManipulableTerrainElement>::iterator it = start; it != elements.end();) {
-				ManipulableTerrainElement& element = const_cast<ManipulableTerrainElement&>(*it); // Const can be cast away since the hash relevant data is not changed
-				element.Unload();
-				it = elements.erase(it);
+		unsigned int maxNumElements = getElementShare(1.0f); // The part of the budget left to the spawn circle of the camera
+		if (elements.size() > maxNumElements) {
+			std::lock_guard<std::mutex> lock(m_updating);
+			// Take the farthest elements out of the grid, they are freed once no worker uses them anymore
+			std::vector<std::pair<float, ElementKey>> sortedElements;
+			for (ElementGrid::iterator it = elements.begin(); it != elements.end(); it++) {
+				Vector3 elementCenter = Vector3Add(it->getPosition(), { (settings->numWidth - 1) * settings->spacing / 2.0f, 0.0f, (settings->numHeight - 1) * settings->spacing / 2.0f });
+				sortedElements.push_back({ Vector2Distance({ elementCenter.x, elementCenter.z }, { center.x, center.z }), it->getKey() });
 			}
+			std::sort(sortedElements.begin(), sortedElements.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+			for (size_t i = maxNumElements; i < sortedElements.size(); i++) {
+				ElementKey key = sortedElements[i].second;
+				dropGridElement(elements.release(key.getCellX(), key.getCellZ()));
+			}
+			m_spawnColumns.clear();
+			publishSnapshot();
 		
 			updateModel();
 		}
 		
 		// Check for radius and maxNumElements increase (for example when circle has been cutoff, so increase elements if that happened)
-		if (elements.size() < settings->maxNumElements || settings->radius != oldSpawnRadius) {
+		if (elements.size() < maxNumElements || settings->radius != oldSpawnRadius) {
 			updateElementPositions();
 		}
 
 		TraceLog(LOG_DEBUG, "Terrain: Terrain has been updated");
 	}
 
-	void TerrainManager::renewTerrain() {
-		UnloadModel(m_model);
-		*modelUploaded = false;
+	void TerrainManager::renewTerrain(terrain_settings terrainSettings) {
+		// The retired elements are only freed once their snapshot is gone, so holding on to it keeps the old terrain drawable
+		// A renewal that has not finished yet never got drawn, so the terrain from before it stays the one on screen
+		if (!m_outgoingSnapshot.load()) m_outgoingSnapshot.store(getSnapshot());
+
+		// Old elements keep pointing at the settings they were made with, so jobs still running on them never see the new grid
+		// Workers only read the pointer while holding m_updating, so only swapping it waits for a relocation in progress
+		{
+			std::lock_guard<std::mutex> lock(m_updating);
+			settings = std::make_shared<terrain_settings>(terrainSettings);
+		}
+
+		// Queued like a relocation, so the main thread keeps drawing instead of waiting for a relocation in progress
+		m_numQueuedRenewals++;
+		auto renew = [this]() {
+			std::lock_guard<std::mutex> lock(m_updating);
+			renewElements();
+			m_numQueuedRenewals--;
+			};
+		if (settings->updateWithThreadPool && settings->threadPool) settings->threadPool->addTask(renew, nullptr);
+		else renew();
+	}
+
+	void TerrainManager::renewElements() {
+		// Has to happen while the old elements are still in the grid and before the new ones look for their diffs
+		resampleDiffs();
 
-		for (std::unordered_set<ManipulableTerrainElement>::iterator it = elements.begin(); it != elements.end(); it++) {
-			ManipulableTerrainElement& element = const_cast<ManipulableTerrainElement&>(*it); // Const can be cast away since the hash relevant data is not changed
-			element.UnloadLayers();
+		// The grid of every element changes, so no element can be kept. Elements own their meshes, so they free them themselves
+		std::vector<std::unique_ptr<ManipulableTerrainElement>> released;
+		elements.releaseAll(released);
+		for (std::unique_ptr<ManipulableTerrainElement>& element : released) {
+			retireElement(std::move(element));
 		}
+		retireWarmElements(false);
+		releaseInterestRegions();
+		m_spawnColumns.clear();
+		m_renderQueueDirty.store(true);
 
+		// The model is applied by update(), since the main thread writes into it without locking
 		relocateElements();
-		initializeModel();
 
-		TraceLog(LOG_DEBUG, "Terrain: Terrain has been renewed");
+		TraceLog(LOG_DEBUG, "Terrain: Terrain has been renewed, generating it in the background");
+	}
+
+	bool TerrainManager::isRenewing() const {
+		return m_outgoingSnapshot.load() != nullptr;
 	}
 
 	void TerrainManager::relocateElements() {
 		TraceLog(LOG_DEBUG, "Terrain: Relocating elements of terrain");
 
-		std::unordered_set<ManipulableTerrainElement> newElements;
-
 		Vector3 position = { 0.0f, 0.0f, 0.0f };
 		if (settings->followCamera && settings->camera) position = Vector3Subtract(settings->camera->getPosition(), m_position);
 		center = position;
-		std::vector<PositionIdentifier> allPosIds;
 		// Spawning elements from the bottom left corner
 		float width = (settings->numWidth - 1) * settings->spacing;
 		float height = (settings->numHeight - 1) * settings->spacing;
 		int numPerQuadrantX = round(settings->radius / width);
 		int numPerQuadrantZ = round(settings->radius / height);
-		float x = position.x - numPerQuadrantX * width;
-		float z = position.z - numPerQuadrantZ * height;
-		bool maxElementsReached = false;
-		for (int i = -numPerQuadrantX; i < numPerQuadrantX; i++, x += width) {
-			float circleHeight = getSpawnHeightAtXPos(x - position.x + (width / 2), settings->radius);
-			for (int j = -numPerQuadrantZ; j < numPerQuadrantZ; j++, z += height) {
-				if (std::abs(z - position.z + (height / 2)) > circleHeight) continue;
-
-				PositionIdentifier posId;
-				if (x < 0) {
-					posId.i = -1;
-					posId.x = static_cast<int>(((-x) - width) / width);
-				}
-				else {
-					posId.i = 1;
-					posId.x = static_cast<int>(x / width);
-				}
-				if (z < 0) {
-					posId.n = -1;
-					posId.z = static_cast<int>(((-z) - height) / height);
-				}
-				else {
-					posId.n = 1;
-					posId.z = static_cast<int>(z / height);
+		int originX = static_cast<int>(std::floor(position.x / width)) - numPerQuadrantX;
+		int originZ = static_cast<int>(std::floor(position.z / height)) - numPerQuadrantZ;
+
+		// If the circle kept its shape, then the elements of the old window are exactly the cells of the old circle
+		std::vector<std::pair<int, int>> columns = getSpawnColumns(numPerQuadrantX, numPerQuadrantZ);
+		bool incremental = columns == m_spawnColumns && elements.getWidth() == numPerQuadrantX * 2 && elements.getHeight() == numPerQuadrantZ * 2;
+		int oldOriginX = elements.getOriginX();
+		int oldOriginZ = elements.getOriginZ();
+
+		// Elements that stay inside of the window keep their slot, only the ones that left it are destroyed here
+		std::vector<std::unique_ptr<ManipulableTerrainElement>> released;
+		elements.setWindow(originX, originZ, numPerQuadrantX * 2, numPerQuadrantZ * 2, released);
+		for (std::unique_ptr<ManipulableTerrainElement>& element : released) {
+			dropGridElement(std::move(element));
+		}
+
+		int numColumns = static_cast<int>(columns.size());
+		for (int i = 0; i < numColumns; i++) {
+			int cellX = originX + i;
+			int first = originZ + columns[i].first;
+			int last = originZ + columns[i].second;
+			if (!incremental) {
+				// Cells outside of the circle or past the maximum of elements may still hold an element from before
+				for (int cellZ = originZ; cellZ < originZ + numPerQuadrantZ * 2; cellZ++) {
+					if (cellZ < first || cellZ > last) dropGridElement(elements.release(cellX, cellZ));
+					else if (!elements.get(cellX, cellZ)) initialiseAndAddNewElement(ElementKey(cellX, cellZ));
 				}
+				continue;
+			}
 
-				// If there is already a element present here, then keep it
-				if (elements.size() > 0) {
-					ManipulableTerrainElement element(posId);
-					auto newElement = elements.extract(element);
+			// Only the rim cells the circle lost or gained in this column are visited
+			int oldColumn = cellX - oldOriginX;
+			int oldFirst = 0, oldLast = -1;
+			if (oldColumn >= 0 && oldColumn < numColumns) {
+				oldFirst = oldOriginZ + columns[oldColumn].first;
+				oldLast = oldOriginZ + columns[oldColumn].second;
+			}
+			forEachCellOutside(oldFirst, oldLast, first, last, [this, cellX](int cellZ) { dropGridElement(elements.release(cellX, cellZ)); });
+			forEachCellOutside(first, last, oldFirst, oldLast, [this, cellX](int cellZ) {
+				if (!elements.get(cellX, cellZ)) initialiseAndAddNewElement(ElementKey(cellX, cellZ));
+				});
+		}
+		m_spawnColumns = columns;
+		m_relocationQueued.store(false);
 
-					if (!newElement.empty()) {
-						newElements.insert(std::move(newElement));
-						continue;
-					}
-				}
+		publishSnapshot();
+		m_updateModel.store(true);
 
-				// There is no element already present, so make a new one
-				initialiseAndAddNewElement(newElements, posId);
+		// Elements only leave the terrain here, so this is when diffs can start moving into cheaper tiers
+		size_t diffBudget = static_cast<size_t>(settings->diffBudget * 1024.0f * 1024.0f);
+		m_residency.updateDiffs(m_loadedManipulations, center, width, height, settings->numWidth * settings->numHeight * 3, diffBudget);
+		updateManipulationHashStats();
+	}
 
-				if (newElements.size() >= settings->maxNumElements) {
-					maxElementsReached = true;
-					break;
-				}
+	std::vector<std::pair<int, int>> TerrainManager::getSpawnColumns(int numPerQuadrantX, int numPerQuadrantZ) {
+		float width = (settings->numWidth - 1) * settings->spacing;
+		float height = (settings->numHeight - 1) * settings->spacing;
+
+		std::vector<std::pair<float, std::pair<int, int>>> cells;
+		for (int i = 0; i < numPerQuadrantX * 2; i++) {
+			float cellX = (i - numPerQuadrantX) * width + (width / 2);
+			float circleHeight = getSpawnHeightAtXPos(cellX, settings->radius);
+			for (int j = 0; j < numPerQuadrantZ * 2; j++) {
+				float cellZ = (j - numPerQuadrantZ) * height + (height / 2);
+				if (std::abs(cellZ) <= circleHeight) cells.push_back({ cellX * cellX + cellZ * cellZ, { i, j } });
 			}
-			z = position.z - numPerQuadrantZ * height;
-			if (maxElementsReached) break;
 		}
 
-		// Set new elements and elements that aren't needed anymore
-		elements.clear();
-		elements = std::move(newElements);
-		m_updateModel.store(true);
+		// Past the maximum of elements only the closest cells are kept, which is a smaller circle, so every column stays one range
+		unsigned int maxNumElements = getElementShare(1.0f);
+		if (cells.size() > maxNumElements) {
+			std::nth_element(cells.begin(), cells.begin() + maxNumElements, cells.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+			cells.resize(maxNumElements);
+		}
+
+		std::vector<std::pair<int, int>> columns(numPerQuadrantX * 2, { 0, -1 });
+		for (auto& [distance, cell] : cells) {
+			std::pair<int, int>& column = columns[cell.first];
+			if (column.first > column.second) column = { cell.second, cell.second };
+			else column = { std::min(column.first, cell.second), std::max(column.second, cell.second) };
+		}
+
+		return columns;
+	}
+
+	unsigned int TerrainManager::getElementShare(float weight) const {
+		// The camera has a weight of 1, every interest region gets its part of the budget by its own weight
+		float totalWeight = 1.0f;
+		for (const InterestRegion& region : m_interestRegions) {
+			totalWeight += region.weight;
+		}
+		return static_cast<unsigned int>(std::floor(getMaxNumElements() * (weight / totalWeight)));
+	}
+
+	unsigned int TerrainManager::getMaxNumElements() const {
+		size_t cpuBudget = static_cast<size_t>(settings->cpuBudget * 1024.0f * 1024.0f);
+		return std::min(settings->maxNumElements, ResidencyManager::getMaxElements(cpuBudget, settings->numWidth, settings->numHeight));
 	}
 
 	void TerrainManager::manipulateTerrain(ManipulableTerrainElement::ManipulateDir dir, ManipulableTerrainElement::ManipulateForm form, ManipulableTerrainElement::ManipulateType type, float strength, float radius, Vector3 position) {
+		// The terrain on screen is about to be thrown away and the new one is not visible yet, so no edit would end up where it was made
+		if (isRenewing()) return;
+
 		// TODO: Make it so that not all elements are manipulated, but only the ones that are in the radius of the manipulation
-		for (std::unordered_set<ManipulableTerrainElement>::iterator it = elements.begin(); it != elements.end(); it++) {
-			ManipulableTerrainElement& element = const_cast<ManipulableTerrainElement&>(*it); // Const can be cast away since the hash relevant data is not changed
-			element.manipulateTerrain(dir, form, type, strength, radius, Vector3Subtract(position, element.getPosition()));
+		for (ManipulableTerrainElement* element : getSnapshot()->elements) {
+			element->manipulateTerrain(dir, form, type, strength, radius, Vector3Subtract(position, element->getPosition()));
+			growTerrainBounds(*element);
 		}
 	}
 
 	void TerrainManager::update(int targetFPS) {
-		if (!m_updating.try_lock()) return;
-		double start = GetTime();
-		for (std::unordered_set<ManipulableTerrainElement>::iterator it = elements.begin(); it != elements.end(); it++) {
-			ManipulableTerrainElement& element = const_cast<ManipulableTerrainElement&>(*it);
-			element.update(targetFPS);
-			double elapsed = GetTime() - start;
-			if (elapsed > 1.0f / targetFPS) {
+		m_frameBudget.beginFrame(GetFrameTime(), 1.0f / targetFPS);
+		// The old elements would be updated with the settings of the renewal, so they are only drawn until it replaced them
+		if (m_numQueuedRenewals.load() > 0) {
+			m_frameBudget.endFrame();
+			return;
+		}
+		updateCameraVelocity();
+		dispatchGenerationJobs();
+		updateBufferArenas();
+		// Only the elements themselves are changed here, so a relocation running on a worker does not hold this up
+		std::shared_ptr<const ElementSnapshot> snapshot = getSnapshot();
+		// m_updateModel only gets checked, once every element has been updated
+		if (updateSnapshotElements(snapshot, targetFPS)) {
+			updateResidency(snapshot);
+			updateOutgoingTerrain(snapshot);
+			if (m_updating.try_lock()) {
+				updateGrid();
 				m_updating.unlock();
-				return; // Returning, so that m_updateModel only get checked, once every element has been updated
 			}
 		}
-		if (m_updateModel.load()) {
+		m_frameBudget.endFrame();
+	}
+
+	bool TerrainManager::updateSnapshotElements(const std::shared_ptr<const ElementSnapshot>& snapshot, int targetFPS) {
+		size_t numElements = snapshot->elements.size();
+		if (numElements == 0) return true;
+
+		// Starting where the last frame ran out of time, so the elements at the end of the snapshot get their turn as well
+		size_t first = m_updateCursor < numElements ? m_updateCursor : 0;
+		size_t numUpdated = 0;
+		while (numUpdated < numElements) {
+			ManipulableTerrainElement* element = snapshot->elements[(first + numUpdated) % numElements];
+			numUpdated++;
+			// Uploads that do not fit into this frame stay pending, the element sends them once its turn comes again
+			if (m_frameBudget.tryUpload(element->getPendingUploadBytes())) element->update(targetFPS);
+			if (settings->simplifyMeshes) {
+				if (element->isGpuResident() && element->needsSimplification(settings->simplificationError)) simplifyElement(element);
+			}
+			else element->dropSimplifiedMesh();
+			if (element->consumeDrawMeshChanged() && element->getModelSlot() != -1) m_model.meshes[element->getModelSlot()] = element->refDrawMesh();
+			growTerrainBounds(*element);
+			if (!m_frameBudget.hasTimeLeft()) break;
+		}
+		m_updateCursor = (first + numUpdated) % numElements;
+
+		m_numUpdatedElements += numUpdated;
+		if (m_numUpdatedElements < numElements) return false;
+		m_numUpdatedElements = 0;
+		return true;
+	}
+
+	void TerrainManager::updateOutgoingTerrain(const std::shared_ptr<const ElementSnapshot>& snapshot) {
+		if (!m_outgoingSnapshot.load() || m_numQueuedRenewals.load() > 0) return;
+		for (ManipulableTerrainElement* element : snapshot->elements) {
+			if (!element->isReady()) return;
+		}
+
+		// Swapped as a whole, since the old and new elements differ in size and would overlap if mixed
+		m_outgoingSnapshot.store(nullptr);
+		m_renderQueueDirty.store(true);
+		TraceLog(LOG_DEBUG, "Terrain: Renewed terrain is ready and replaced the old one");
+	}
+
+	void TerrainManager::updateGrid() {
+		// Applying the model changes is skipped if the elements used up the frame, they are still queued next frame
+		if ((m_updateModel.load() || !m_modelChanges.empty()) && m_frameBudget.hasTimeLeft()) {
 			updateModel();
 			m_updateModel.store(false);
 		}
-
-		if (settings->followCamera) {
-			float cameraDistToCenter = Vector2Distance(Vector2{ settings->camera->getPosition().x, settings->camera->getPosition().z }, Vector2{ center.x, center.z });
-			if (cameraDistToCenter > settings->distToRelocating) updateElementPositions();
+		// The model does not reference retired elements anymore once every change has been applied, so they can be freed now
+		if (m_modelChanges.empty()) updateRetiredElements();
+		updateDiffResamples();
+		updatePrefetch();
+		updateInterestRegions();
+		updateManipulationHashStats();
+
+		if (settings->followCamera && !m_relocationQueued.load()) {
+			// The circle is placed by the cell the camera is in, so nothing changes until the camera crosses into another cell
+			float width = (settings->numWidth - 1) * settings->spacing;
+			float height = (settings->numHeight - 1) * settings->spacing;
+			Vector3 cameraPosition = Vector3Subtract(settings->camera->getPosition(), m_position);
+			bool crossedCell = std::floor(cameraPosition.x / width) != std::floor(center.x / width) || std::floor(cameraPosition.z / height) != std::floor(center.z / height);
+			float cameraDistToCenter = Vector2Distance(Vector2{ cameraPosition.x, cameraPosition.z }, Vector2{ center.x, center.z });
+			if (crossedCell && cameraDistToCenter > settings->distToRelocating) updateElementPositions();
 		}
-		m_updating.unlock();
 	}
 
 	void TerrainManager::draw() {
-		// activate();
-		ModelObject::draw(m_position);
-		// deactivate();
+		// Drawn from the published snapshot, so a relocation running on a worker never has to be waited for
+		drawElements();
+	}
+
+	void TerrainManager::drawElementNormals(ManipulableTerrainElement& element, const BoundingBox& box, Matrix transform) {
+		if (m_normalsDistance > 0.0f && settings->camera) {
+			Vector3 cameraPosition = settings->camera->getPosition();
+			Vector3 closest = Vector3Clamp(cameraPosition, box.min, box.max);
+			if (Vector3Distance(cameraPosition, closest) > m_normalsDistance) return;
+		}
+
+		// Drawn through the render batch of rlgl with its default shader, so there is no material to load or free
+		Vector3 offset = element.getPosition();
+		MeshRenderer::drawLines(element.refNormalLines(), MatrixMultiply(MatrixTranslate(offset.x, offset.y, offset.z), transform), RED);
+	}
+
+	Matrix TerrainManager::getModelTransform() const {
+		// Same transformation DrawModel() would apply
+		return MatrixMultiply(m_model.transform, MatrixMultiply(MatrixScale(m_scale, m_scale, m_scale), MatrixTranslate(m_position.x, m_position.y, m_position.z)));
+	}
+
+	void TerrainManager::drawElements() {
+		if (m_model.materialCount == 0) return;
+
+		// Same transformation and tint DrawModel() would apply, every element is translated to its position on top of it
+		Matrix transform = getModelTransform();
+		Material& material = m_model.materials[0];
+		Color color = material.maps[MATERIAL_MAP_DIFFUSE].color;
+		material.maps[MATERIAL_MAP_DIFFUSE].color = ColorTint(color, m_tint);
+		Shader shader = material.shader;
+		bool normalMaps = useTerrainShader(material);
+
+		bool cull = m_frustumCulling && settings->camera;
+		Frustum frustum;
+		if (cull) frustum = Frustum(settings->camera->getCamera(), static_cast<float>(GetScreenWidth()) / GetScreenHeight());
+
+		updateRenderQueue();
+
+		bool occlude = m_occlusionCulling && settings->camera;
+		if (occlude) m_horizonCuller.reset(settings->camera->getPosition());
+
+		m_numVisibleElements = 0;
+		m_numCulledElements = 0;
+		m_numOccludedElements = 0;
+		m_numVisibleClusters = 0;
+		m_numCulledClusters = 0;
+		if (m_drawWired) rlEnableWireMode();
+		for (ManipulableTerrainElement* queuedElement : m_renderQueue) {
+			ManipulableTerrainElement& element = *queuedElement;
+			if (!element.isDrawable()) continue;
+
+			// Elements outside of the frustum still hide the terrain behind them, so every element is added to the horizon
+			Vector3 offset = element.getPosition();
+			BoundingBox box = toWorldBox(element.getBoundingBox(), offset);
+			if (cull && !frustum.containsBox(box)) {
+				if (occlude) m_horizonCuller.addOccluder(box);
+				m_numCulledElements++;
+				continue;
+			}
+			if (occlude) {
+				bool occluded = m_horizonCuller.isOccluded(box);
+				m_horizonCuller.addOccluder(box);
+				if (occluded) {
+					m_numOccludedElements++;
+					continue;
+				}
+			}
+
+			// Simplified meshes have their own index buffer, so clusters only apply to the full mesh
+			Mesh& mesh = element.refDrawMesh();
+			bool fullMesh = &mesh == &element.refMesh();
+			m_visibleRanges.clear();
+			if (cull && fullMesh && element.getClusters().size() > 1) collectVisibleClusters(element, frustum);
+			else {
+				m_visibleRanges.push_back({ 0, mesh.triangleCount * 3 });
+				m_numVisibleClusters += static_cast<int>(element.getClusters().size());
+			}
+			m_numVisibleElements++;
+			if (m_drawNormals) drawElementNormals(element, box, transform);
+
+			// Elements in the current arena are drawn together after all others, so buffers and shader are only bound once
+			if (fullMesh && element.getArenaSlot() != -1 && element.getArena() == settings->bufferArena.get()) {
+				for (const MeshRenderer::IndexRange& range : m_visibleRanges) {
+					m_arenaCommands.push_back({ element.getArenaSlot(), range, offset });
+				}
+			}
+			else if (fullMesh && element.getArenaSlot() != -1) {
+				element.getArena()->draw(material, transform, { { element.getArenaSlot(), { 0, mesh.triangleCount * 3 }, offset } });
+			}
+			else {
+				// Simplified meshes lost the detail of the full mesh, so their lighting comes from the baked normal map
+				Texture2D normalMap = normalMaps ? element.getNormalMap() : Texture2D{ 0 };
+				if (normalMap.id != 0) setNormalMap(material, normalMap);
+				MeshRenderer::drawMeshRanges(mesh, material, MatrixMultiply(MatrixTranslate(offset.x, offset.y, offset.z), transform), m_visibleRanges);
+				if (normalMap.id != 0) setNormalMap(material, { 0 });
+			}
+		}
+		if (settings->bufferArena) settings->bufferArena->draw(material, transform, m_arenaCommands);
+		m_arenaCommands.clear();
+		if (m_drawWired) rlDisableWireMode();
+
+		material.maps[MATERIAL_MAP_DIFFUSE].color = color;
+		material.shader = shader;
+	}
+
+	void TerrainManager::updateRenderQueue() {
+		// The order only depends on the camera position, so it is kept until the camera moved half an element or the elements changed
+		bool sort = m_sortFrontToBack && settings->camera;
+		Vector3 cameraPosition = sort ? settings->camera->getPosition() : m_renderQueuePosition;
+		float resortDistance = std::min(settings->numWidth - 1, settings->numHeight - 1) * settings->spacing * m_scale / 2.0f;
+		std::shared_ptr<const ElementSnapshot> snapshot = getDrawnSnapshot();
+		if (!m_renderQueueDirty.load() && snapshot == m_renderSnapshot && Vector3Distance(cameraPosition, m_renderQueuePosition) < resortDistance) return;
+
+		std::vector<std::pair<float, ManipulableTerrainElement*>> sortedElements;
+		sortedElements.reserve(snapshot->elements.size());
+		for (ManipulableTerrainElement* element : snapshot->elements) {
+			BoundingBox box = toWorldBox(element->getBoundingBox(), element->getPosition());
+			Vector3 center = Vector3Scale(Vector3Add(box.min, box.max), 0.5f);
+			sortedElements.push_back({ Vector3DistanceSqr(cameraPosition, center), element });
+		}
+		if (sort) std::sort(sortedElements.begin(), sortedElements.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+		m_renderQueue.clear();
+		for (auto& [distance, element] : sortedElements) {
+			m_renderQueue.push_back(element);
+		}
+		m_renderSnapshot = snapshot;
+		m_renderQueuePosition = cameraPosition;
+		m_renderQueueDirty.store(false);
+	}
+
+	void TerrainManager::collectVisibleClusters(ManipulableTerrainElement& element, const Frustum& frustum) {
+		// Clusters are stored consecutively in the index buffer, so neighbouring visible clusters merge into one range
+		for (const TerrainElement::Cluster& cluster : element.getClusters()) {
+			if (!frustum.containsBox(toWorldBox(cluster.boundingBox, element.getPosition()))) {
+				m_numCulledClusters++;
+				continue;
+			}
+
+			if (!m_visibleRanges.empty() && m_visibleRanges.back().offset + m_visibleRanges.back().count == cluster.indexOffset) m_visibleRanges.back().count += cluster.indexCount;
+			else m_visibleRanges.push_back({ cluster.indexOffset, cluster.indexCount });
+			m_numVisibleClusters++;
+		}
+	}
+
+	void TerrainManager::updateResidency(const std::shared_ptr<const ElementSnapshot>& snapshot) {
+		Vector3 viewPosition = center;
+		if (settings->camera) viewPosition = Vector3Scale(Vector3Subtract(settings->camera->getPosition(), m_position), 1.0f / m_scale);
+
+		// The order only changes if the camera moved or the elements changed, so the tiers are kept until then
+		float moveDistance = std::min(settings->numWidth - 1, settings->numHeight - 1) * settings->spacing / 2.0f;
+		bool budgetChanged = settings->gpuBudget != m_residencyBudget || settings->pinDistance != m_residencyPinDistance;
+		if (!budgetChanged && snapshot == m_residencySnapshot && Vector3Distance(viewPosition, m_residencyPosition) < moveDistance) return;
+
+		size_t gpuBudget = static_cast<size_t>(settings->gpuBudget * 1024.0f * 1024.0f);
+		m_residency.updateElements(snapshot->elements, viewPosition, gpuBudget, settings->pinDistance);
+		m_residencySnapshot = snapshot;
+		m_residencyPosition = viewPosition;
+		m_residencyBudget = settings->gpuBudget;
+		m_residencyPinDistance = settings->pinDistance;
+	}
+
+	ResidencyManager::TierStats TerrainManager::getResidencyStats() const {
+		return m_residency.getStats();
+	}
+
+	const FrameBudget& TerrainManager::getFrameBudget() const {
+		return m_frameBudget;
+	}
+
+	DiffResampler::Layout TerrainManager::getDiffLayout() const {
+		return { settings->numWidth, settings->numHeight, settings->spacing };
+	}
+
+	void TerrainManager::resampleDiffs() {
+		DiffResampler::Layout layout = getDiffLayout();
+		if (layout == m_diffLayout) return;
+
+		// Unedited elements mark their diff with NaN once they are destroyed, so their diffs are left out instead of being read while that happens
+		std::unordered_set<ElementKey, ElementKeyHash> uneditedKeys;
+		auto addUnedited = [&uneditedKeys](const ManipulableTerrainElement* element) {
+			if (element && !element->getHasDifference() && element->getDifference()) uneditedKeys.insert(element->getKey());
+			};
+		for (ManipulableTerrainElement* element : getSnapshot()->elements) addUnedited(element);
+		for (auto& [key, element] : m_warmElements) addUnedited(element.get());
+		for (RetiredElement& retired : m_retiredElements) addUnedited(retired.element.get());
+
+		// Nothing is decoded or resampled here, the tasks of the new cells load the sources they overlap
+		size_t sourceSize = static_cast<size_t>(m_diffLayout.numWidth) * m_diffLayout.numHeight * 3;
+		std::unordered_map<ElementKey, std::shared_ptr<DiffSource>, ElementKeyHash> sources;
+		for (auto& [key, diff] : m_loadedManipulations) {
+			if (uneditedKeys.contains(key)) continue;
+
+			std::shared_ptr<DiffSource> source = std::make_shared<DiffSource>();
+			source->size = sourceSize;
+			DiffResampleMap::iterator pending = m_diffResamples.find(key);
+			if (pending != m_diffResamples.end() && !pending->second->filled.load()) source->pending = pending->second; // The target is still written, so it is chained instead of read
+			else if (std::isnan(diff[0])) continue;
+			else source->diff = diff;
+			sources[key] = source;
+		}
+		// The new cells may reuse the keys of diffs in a cheaper tier, so those are taken out and the tiers start out empty
+		for (auto& [key, stored] : m_residency.takeStoredDiffs()) {
+			std::shared_ptr<DiffSource> source = std::make_shared<DiffSource>();
+			source->size = sourceSize;
+			source->stored = std::move(stored);
+			sources[key] = source;
+		}
+		m_diffResamples.clear();
+		m_loadedManipulations.clear();
+
+		// Every new cell gets one task, reading only the old diffs it overlaps
+		for (auto& [sourceKey, source] : sources) {
+			for (ElementKey key : DiffResampler::getCoveredKeys(sourceKey, m_diffLayout, layout)) {
+				std::shared_ptr<DiffResample>& resample = m_diffResamples[key];
+				if (!resample) {
+					resample = std::make_shared<DiffResample>();
+					resample->key = key;
+					resample->from = m_diffLayout;
+					resample->to = layout;
+					resample->target = std::shared_ptr<float[]>(new float[layout.numWidth * layout.numHeight * 3], std::default_delete<float[]>());
+					m_loadedManipulations[key] = resample->target;
+				}
+				resample->sources[sourceKey] = source;
+			}
+		}
+		for (auto& [key, resample] : m_diffResamples) {
+			if (settings->updateWithThreadPool && settings->threadPool) settings->threadPool->addTask([resample]() { runDiffResample(*resample); }, &resample->done);
+			else {
+				runDiffResample(*resample);
+				resample->done.store(true);
+			}
+		}
+		m_numDiffResamples.store(static_cast<int>(m_diffResamples.size()));
+
+		TraceLog(LOG_DEBUG, "Terrain: Resampling %i diffs from %ix%i to %ix%i vertices", static_cast<int>(sources.size()), m_diffLayout.numWidth, m_diffLayout.numHeight, layout.numWidth, layout.numHeight);
+		m_diffLayout = layout;
+	}
+
+	void TerrainManager::runDiffResample(DiffResample& resample) {
+		std::call_once(resample.resampled, [&resample]() {
+			ResidencyManager::DiffMap sources;
+			for (auto& [key, source] : resample.sources) {
+				loadDiffSource(*source);
+				if (source->diff) sources[key] = source->diff;
+			}
+			DiffResampler::resample(sources, resample.from, resample.key, resample.to, resample.target.get());
+			resample.sources.clear();
+			resample.filled.store(true);
+			});
+	}
+
+	void TerrainManager::loadDiffSource(DiffSource& source) {
+		std::call_once(source.loaded, [&source]() {
+			if (source.pending) {
+				runDiffResample(*source.pending);
+				source.diff = source.pending->target;
+				source.pending = nullptr;
+			}
+			else if (!source.diff) {
+				std::vector<float> diff = ResidencyManager::decodeDiff(source.stored);
+				source.stored = {};
+				if (diff.size() != source.size) return;
+				source.diff = std::shared_ptr<float[]>(new float[diff.size()], std::default_delete<float[]>());
+				std::copy(diff.begin(), diff.end(), source.diff.get());
+			}
+			});
+	}
+
+	void TerrainManager::updateDiffResamples() {
+		for (DiffResampleMap::iterator it = m_diffResamples.begin(); it != m_diffResamples.end();) {
+			if (it->second->done.load()) it = m_diffResamples.erase(it);
+			else it++;
+		}
+		m_numDiffResamples.store(static_cast<int>(m_diffResamples.size()));
+	}
+
+	int TerrainManager::getNumDiffResamples() const {
+		return m_numDiffResamples.load();
+	}
+
+	int TerrainManager::addInterestRegion(Character* viewer, float radius, float weight) {
+		InterestRegionChange change{ InterestRegionChange::ADD };
+		change.region.id = m_nextInterestRegionId++;
+		change.region.viewer = viewer;
+		change.region.radius = radius;
+		change.region.weight = std::max(weight, 0.0f);
+		queueInterestRegionChange(change);
+		return change.region.id;
+	}
+
+	int TerrainManager::addInterestRegion(Vector3 position, float radius, float weight) {
+		int id = addInterestRegion(nullptr, radius, weight);
+		setInterestRegionPosition(id, position);
+		return id;
+	}
+
+	void TerrainManager::removeInterestRegion(int id) {
+		InterestRegionChange change{ InterestRegionChange::REMOVE };
+		change.region.id = id;
+		queueInterestRegionChange(change);
+	}
+
+	void TerrainManager::setInterestRegionPosition(int id, Vector3 position) {
+		InterestRegionChange change{ InterestRegionChange::MOVE };
+		change.region.id = id;
+		change.region.position = position;
+		queueInterestRegionChange(change);
+	}
+
+	void TerrainManager::setInterestRegion(int id, float radius, float weight) {
+		InterestRegionChange change{ InterestRegionChange::RESHAPE };
+		change.region.id = id;
+		change.region.radius = radius;
+		change.region.weight = std::max(weight, 0.0f);
+		queueInterestRegionChange(change);
+	}
+
+	void TerrainManager::queueInterestRegionChange(InterestRegionChange change) {
+		std::lock_guard<std::mutex> lock(m_interestRegionChangesMutex);
+		m_interestRegionChanges.push_back(change);
+	}
+
+	bool TerrainManager::applyInterestRegionChanges() {
+		std::vector<InterestRegionChange> changes;
+		{
+			std::lock_guard<std::mutex> lock(m_interestRegionChangesMutex);
+			changes.swap(m_interestRegionChanges);
+		}
+
+		bool budgetChanged = false;
+		for (InterestRegionChange& change : changes) {
+			if (change.type == InterestRegionChange::ADD) {
+				m_interestRegions.push_back(change.region);
+				budgetChanged = true;
+				continue;
+			}
+
+			std::vector<InterestRegion>::iterator it = std::find_if(m_interestRegions.begin(), m_interestRegions.end(), [&change](const InterestRegion& region) { return region.id == change.region.id; });
+			if (it == m_interestRegions.end()) continue;
+
+			if (change.type == InterestRegionChange::REMOVE) {
+				for (ElementKey key : it->cells) {
+					releaseSharedElement(key);
+				}
+				m_interestRegions.erase(it);
+				budgetChanged = true;
+			}
+			else if (change.type == InterestRegionChange::MOVE) it->position = change.region.position;
+			else {
+				it->radius = change.region.radius;
+				it->weight = change.region.weight;
+				budgetChanged = true;
+			}
+		}
+		return budgetChanged;
+	}
+
+	int TerrainManager::getNumInterestRegions() const {
+		return m_numInterestRegions.load();
+	}
+
+	int TerrainManager::getNumSharedElements() const {
+		return m_numSharedElements.load();
+	}
+
+	void TerrainManager::onInterestRegionsChanged() {
+		// The weights split the budget, so every region and the spawn circle of the camera have to pick their cells again
+		for (InterestRegion& region : m_interestRegions) {
+			region.dirty = true;
+		}
+		m_numInterestRegions.store(static_cast<int>(m_interestRegions.size()));
+		m_spawnColumns.clear();
+		// Queued like any other relocation, a relocation that is already queued picks up the cleared columns
+		if (!m_relocationQueued.load()) updateElementPositions();
+	}
+
+	void TerrainManager::updateInterestRegions() {
+		bool budgetChanged = applyInterestRegionChanges();
+		if (budgetChanged) onInterestRegionsChanged();
+		if (m_interestRegions.empty()) {
+			// Removing the last region only released its cells, the snapshot still has to lose the elements the regions owned
+			if (budgetChanged) {
+				m_numSharedElements.store(static_cast<int>(m_sharedElements.size()));
+				publishSnapshot();
+				m_updateModel.store(true);
+			}
+			return;
+		}
+
+		float width = (settings->numWidth - 1) * settings->spacing;
+		float height = (settings->numHeight - 1) * settings->spacing;
+		bool changed = false;
+		for (InterestRegion& region : m_interestRegions) {
+			Vector3 position = Vector3Subtract(region.viewer ? region.viewer->getPosition() : region.position, m_position);
+			int cellX = static_cast<int>(std::floor(position.x / width));
+			int cellZ = static_cast<int>(std::floor(position.z / height));
+
+			// Like the spawn circle, the cells of a region only change once its center crossed into another cell
+			if (!region.dirty && cellX == region.cellX && cellZ == region.cellZ) continue;
+
+			region.dirty = false;
+			region.cellX = cellX;
+			region.cellZ = cellZ;
+			changed = true;
+
+			int numX = static_cast<int>(std::ceil(region.radius / width));
+			int numZ = static_cast<int>(std::ceil(region.radius / height));
+			std::vector<std::pair<float, ElementKey>> cells;
+			for (int x = cellX - numX; x <= cellX + numX; x++) {
+				for (int z = cellZ - numZ; z <= cellZ + numZ; z++) {
+					float distance = Vector2Distance({ (x + 0.5f) * width, (z + 0.5f) * height }, { position.x, position.z });
+					if (distance <= region.radius) cells.push_back({ distance, ElementKey(x, z) });
+				}
+			}
+			unsigned int maxNumElements = getElementShare(region.weight);
+			if (cells.size() > maxNumElements) {
+				std::nth_element(cells.begin(), cells.begin() + maxNumElements, cells.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+				cells.resize(maxNumElements);
+			}
+
+			// Acquiring first, so cells both sets share never drop to zero references in between
+			std::vector<ElementKey> oldCells = std::move(region.cells);
+			region.cells.clear();
+			for (auto& [distance, key] : cells) {
+				acquireSharedElement(key);
+				region.cells.push_back(key);
+			}
+			for (ElementKey key : oldCells) {
+				releaseSharedElement(key);
+			}
+		}
+
+		if (!changed) return;
+		m_numSharedElements.store(static_cast<int>(m_sharedElements.size()));
+		publishSnapshot();
+		m_updateModel.store(true);
+	}
+
+	void TerrainManager::acquireSharedElement(ElementKey key) {
+		SharedElement& shared = m_sharedElements[key];
+		if (shared.refCount++ > 0 || elements.find(key)) return;
+
+		// Not in the grid, so the region owns the element, it is only generated once however many regions reference it
+		WarmElementMap::iterator warm = m_warmElements.find(key);
+		if (warm != m_warmElements.end()) {
+			m_generationScheduler.promote(key);
+			shared.element = std::move(warm->second);
+			m_warmElements.erase(warm);
+			m_numWarmElements.store(static_cast<int>(m_warmElements.size()));
+		}
+		else shared.element = createElement(key, false);
+		m_modelChanges.push_back({ shared.element.get(), true });
+	}
+
+	void TerrainManager::releaseSharedElement(ElementKey key) {
+		SharedElementMap::iterator it = m_sharedElements.find(key);
+		if (it == m_sharedElements.end() || --it->second.refCount > 0) return;
+
+		// An element the grid owns stays where it is, only the ones owned by the regions leave the terrain
+		retireElement(std::move(it->second.element));
+		m_sharedElements.erase(it);
+	}
+
+	void TerrainManager::releaseInterestRegions() {
+		for (auto& [key, shared] : m_sharedElements) {
+			retireElement(std::move(shared.element));
+		}
+		m_sharedElements.clear();
+		for (InterestRegion& region : m_interestRegions) {
+			region.cells.clear();
+			region.dirty = true;
+		}
+		m_numSharedElements.store(0);
+	}
+
+	void TerrainManager::dropGridElement(std::unique_ptr<ManipulableTerrainElement> element) {
+		if (!element) return;
+
+		// Still referenced by an interest region, so the region takes the element over instead of it being generated again
+		SharedElementMap::iterator shared = m_sharedElements.find(element->getKey());
+		if (shared != m_sharedElements.end()) {
+			shared->second.element = std::move(element);
+			return;
+		}
+		retireElement(std::move(element));
+	}
+
+	void TerrainManager::updateCameraVelocity() {
+		float frameTime = GetFrameTime();
+		if (!settings->camera || frameTime <= 0.0f) return;
+
+		// Smoothed over a few frames, so single jerky frames don't move the prefetched band around
+		Vector3 cameraPosition = settings->camera->getPosition();
+		if (m_hasCameraPosition) {
+			Vector3 velocity = Vector3Scale(Vector3Subtract(cameraPosition, m_lastCameraPosition), 1.0f / frameTime);
+			m_cameraVelocity = Vector3Lerp(m_cameraVelocity, velocity, 0.2f);
+		}
+		m_lastCameraPosition = cameraPosition;
+		m_hasCameraPosition = true;
+	}
+
+	void TerrainManager::updatePrefetch() {
+		if (settings->prefetchTime <= 0.0f || !settings->followCamera || !settings->camera || !settings->updateWithThreadPool || !settings->threadPool) {
+			retireWarmElements(false);
+			return;
+		}
+
+		float width = (settings->numWidth - 1) * settings->spacing;
+		float height = (settings->numHeight - 1) * settings->spacing;
+		Vector3 lookahead = Vector3Scale(m_cameraVelocity, settings->prefetchTime / m_scale);
+		lookahead.y = 0.0f;
+		Vector3 predicted = Vector3Add(Vector3Subtract(settings->camera->getPosition(), m_position), lookahead);
+		m_prefetchCenter = predicted;
+
+		// Warm elements the camera is not heading to anymore are dropped again
+		retireWarmElements(true);
+
+		// Standing still or moving slowly, the regular relocation keeps up on its own
+		if (Vector3Length(lookahead) < std::min(width, height) / 2.0f) return;
+
+		// The cells around the predicted position that the current spawn circle does not cover yet, closest to the prediction first
+		int firstX = static_cast<int>(std::floor((predicted.x - settings->radius) / width));
+		int lastX = static_cast<int>(std::floor((predicted.x + settings->radius) / width));
+		int firstZ = static_cast<int>(std::floor((predicted.z - settings->radius) / height));
+		int lastZ = static_cast<int>(std::floor((predicted.z + settings->radius) / height));
+		std::vector<std::pair<float, ElementKey>> band;
+		for (int cellX = firstX; cellX <= lastX; cellX++) {
+			for (int cellZ = firstZ; cellZ <= lastZ; cellZ++) {
+				Vector2 cellCenter = { (cellX + 0.5f) * width, (cellZ + 0.5f) * height };
+				float predictedDistance = Vector2Distance(cellCenter, { predicted.x, predicted.z });
+				if (predictedDistance > settings->radius) continue;
+				if (Vector2Distance(cellCenter, { center.x, center.z }) <= settings->radius) continue;
+
+				ElementKey key(cellX, cellZ);
+				if (elements.find(key) || m_warmElements.find(key) != m_warmElements.end() || m_sharedElements.find(key) != m_sharedElements.end()) continue;
+				band.push_back({ predictedDistance, key });
+			}
+		}
+		std::sort(band.begin(), band.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+		unsigned int maxWarmElements = std::max(1u, settings->maxNumElements / 2);
+		for (auto& [distance, key] : band) {
+			if (m_warmElements.size() >= maxWarmElements) break;
+			m_warmElements[key] = createElement(key, true);
+		}
+		m_numWarmElements.store(static_cast<int>(m_warmElements.size()));
+	}
+
+	void TerrainManager::retireWarmElements(bool onlyUnreachable) {
+		float width = (settings->numWidth - 1) * settings->spacing;
+		float height = (settings->numHeight - 1) * settings->spacing;
+		float keepDistance = settings->radius + std::max(width, height);
+		for (WarmElementMap::iterator it = m_warmElements.begin(); it != m_warmElements.end();) {
+			ElementKey key = it->first;
+			Vector2 cellCenter = { (key.getCellX() + 0.5f) * width, (key.getCellZ() + 0.5f) * height };
+			bool reachable = Vector2Distance(cellCenter, { m_prefetchCenter.x, m_prefetchCenter.z }) <= keepDistance || Vector2Distance(cellCenter, { center.x, center.z }) <= keepDistance;
+			if (onlyUnreachable && reachable) {
+				it++;
+				continue;
+			}
+			retireElement(std::move(it->second), false);
+			it = m_warmElements.erase(it);
+		}
+		m_numWarmElements.store(static_cast<int>(m_warmElements.size()));
+	}
+
+	int TerrainManager::getNumWarmElements() const {
+		return m_numWarmElements.load();
+	}
+
+	void TerrainManager::dispatchGenerationJobs() {
+		if (!settings->threadPool) return;
+
+		Vector3 viewPosition = center;
+		Vector3 viewDirection = { 0.0f, 0.0f, 0.0f };
+		if (settings->camera) {
+			Camera camera = settings->camera->getCamera();
+			viewPosition = camera.position;
+			viewDirection = Vector3Subtract(camera.target, camera.position);
+		}
+
+		// Only a few jobs wait in the pool at once, so a closer element scheduled later does not queue up behind farther ones
+		m_generationScheduler.dispatch(*settings->threadPool, viewPosition, viewDirection, settings->threadPool->getNumThreads());
+	}
+
+	void TerrainManager::retireElement(std::unique_ptr<ManipulableTerrainElement> element, bool published) {
+		if (!element) return;
+
+		// A job that has not started yet is dropped, a running one keeps the element alive until it is done
+		GenerationScheduler::DoneFlag done = m_generationScheduler.cancel(element->getKey());
+		std::vector<GenerationScheduler::DoneFlag> noiseDone;
+		for (auto& [noiseElement, noiseTask] : m_noiseTasks) {
+			if (noiseElement == element.get() && !noiseTask->load()) noiseDone.push_back(noiseTask);
+		}
+		std::erase_if(m_noiseTasks, [&element](const auto& task) { return task.first == element.get(); });
+		std::weak_ptr<const ElementSnapshot> snapshot;
+		if (published) {
+			snapshot = getSnapshot();
+			m_modelChanges.push_back({ element.get(), false });
+		}
+		// A relocation queued before a renewal can publish a newer snapshot, while the older outgoing one is still drawn
+		std::weak_ptr<const ElementSnapshot> outgoingSnapshot = m_outgoingSnapshot.load();
+		m_retiredElements.push_back({ std::move(element), done, std::move(noiseDone), snapshot, outgoingSnapshot });
+		m_renderQueueDirty.store(true);
+	}
+
+	void TerrainManager::publishSnapshot() {
+		std::shared_ptr<ElementSnapshot> snapshot = std::make_shared<ElementSnapshot>();
+		snapshot->elements.reserve(elements.size());
+		for (ElementGrid::iterator it = elements.begin(); it != elements.end(); it++) {
+			snapshot->elements.push_back(&*it);
+		}
+		for (auto& [key, shared] : m_sharedElements) {
+			if (shared.element) snapshot->elements.push_back(shared.element.get());
+		}
+		m_snapshot.store(snapshot);
+		m_renderQueueDirty.store(true);
+	}
+
+	std::shared_ptr<const TerrainManager::ElementSnapshot> TerrainManager::getDrawnSnapshot() const {
+		std::shared_ptr<const ElementSnapshot> snapshot = m_outgoingSnapshot.load();
+		return snapshot ? snapshot : getSnapshot();
+	}
+
+	std::shared_ptr<const TerrainManager::ElementSnapshot> TerrainManager::getSnapshot() const {
+		return m_snapshot.load();
+	}
+
+	void TerrainManager::updateRetiredElements() {
+		// Freed on the main thread, since elements unload their GPU data when they are destroyed
+		for (std::vector<RetiredElement>::iterator it = m_retiredElements.begin(); it != m_retiredElements.end();) {
+			bool noiseRunning = std::any_of(it->noiseDone.begin(), it->noiseDone.end(), [](const GenerationScheduler::DoneFlag& done) { return !done->load(); });
+			if ((it->done && !it->done->load()) || noiseRunning || it->element->isSimplifying() || !it->snapshot.expired() || !it->outgoingSnapshot.expired()) it++;
+			else it = m_retiredElements.erase(it);
+		}
+	}
+
+	void TerrainManager::updateBufferArenas() {
+		// Elements create a new arena when they don't fit the current one, so it has to be picked up here
+		if (settings->bufferArena && std::find(m_bufferArenas.begin(), m_bufferArenas.end(), settings->bufferArena) == m_bufferArenas.end()) {
+			m_bufferArenas.push_back(settings->bufferArena);
+		}
+
+		for (std::vector<std::shared_ptr<MeshArena>>::iterator it = m_bufferArenas.begin(); it != m_bufferArenas.end();) {
+			if (*it != settings->bufferArena && it->use_count() == 1) it = m_bufferArenas.erase(it);
+			else it++;
+		}
+	}
+
+	void TerrainManager::updateTerrainBounds() {
+		// Elements keep their own bounds current, so the union never has to look at vertices
+		m_boundingBox = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+		m_hasBounds = false;
+		for (ManipulableTerrainElement* element : getSnapshot()->elements) {
+			growTerrainBounds(*element);
+		}
+	}
+
+	void TerrainManager::growTerrainBounds(ManipulableTerrainElement& element) {
+		// Shrinking bounds are only picked up by the next updateTerrainBounds(), until then the union stays conservative
+		if (!element.isDrawable()) return;
+
+		BoundingBox box = element.getBoundingBox();
+		box = { Vector3Add(box.min, element.getPosition()), Vector3Add(box.max, element.getPosition()) };
+		if (!m_hasBounds) m_boundingBox = box;
+		else m_boundingBox = { Vector3Min(m_boundingBox.min, box.min), Vector3Max(m_boundingBox.max, box.max) };
+		m_hasBounds = true;
+	}
+
+	BoundingBox TerrainManager::toWorldBox(BoundingBox box, Vector3 offset) const {
+		box.min = Vector3Add(Vector3Scale(Vector3Add(box.min, offset), m_scale), m_position);
+		box.max = Vector3Add(Vector3Scale(Vector3Add(box.max, offset), m_scale), m_position);
+		return box;
 	}
 
 	void TerrainManager::updateElementPositions() {
 		if (settings->updateWithThreadPool && settings->threadPool) {
+			m_relocationQueued.store(true);
 			auto relocate = [this]() {
 				m_updating.lock();
 				relocateElements();
@@ -478,13 +1545,18 @@ namespace Terrain {
 	RayCollision TerrainManager::getRayCollisionWithTerrain(Ray ray) {
 		RayCollision hit = { 0 };
 
-		for (std::unordered_set<ManipulableTerrainElement>::iterator it = elements.begin(); it != elements.end(); it++) {
-			ManipulableTerrainElement& element = const_cast<ManipulableTerrainElement&>(*it); // Const can be cast away since the hash relevant data is not changed
-			RayCollision boundingBoxHit = GetRayCollisionBox(ray, element.getBoundingBox());
+		// Picks what is on screen, which is the old terrain while a renewal generates
+		for (ManipulableTerrainElement* queriedElement : getDrawnSnapshot()->elements) {
+			ManipulableTerrainElement& element = *queriedElement;
+
+			// Vertices are local to their element, so the ray is moved into the space of the element instead
+			Ray localRay = { Vector3Subtract(ray.position, element.getPosition()), ray.direction };
+			RayCollision boundingBoxHit = GetRayCollisionBox(localRay, element.getBoundingBox());
 			if (boundingBoxHit.hit) {
-				RayCollision elementHit = GetRayCollisionMesh(ray, element.refMesh(), m_model.transform);
+				RayCollision elementHit = GetRayCollisionMesh(localRay, element.refDrawMesh(), m_model.transform);
 				if (elementHit.hit) {
 					hit = elementHit;
+					hit.point = Vector3Add(hit.point, element.getPosition());
 					break;
 				}
 			}